@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bathroom.h"
+
+#define DEFAULT_HZ 10
+#define MIN_HZ 10
+#define MAX_HZ 100
+
+/// @brief Название состояния ванной
+/// @param state состояние
+/// @return
+const char* stateName(Sex state)
+{
+    switch (state) {
+        case man: return "мужчины";
+        case woman: return "женщины";
+        default: return "пусто";
+    }
+}
+
+/// @brief Размер сегмента по fstat
+/// @param fd дескриптор сегмента
+static size_t segFileSize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        exit(1);
+    }
+    return (size_t)st.st_size;
+}
+
+/// @brief Ожидание появления сегмента и подключение к нему только на чтение
+/// @param name имя сегмента
+/// @return снимок ванной
+///
+/// task создает сегмент (shm_open), затем задает размер (ftruncate) и
+/// записывает число студентов: обращение к еще не выделенной странице
+/// дало бы SIGBUS, поэтому ждем размера заголовка, а затем - полного
+/// размера для nstudents
+const BrSnapshot* attach(const char* name)
+{
+    int fd;
+    while ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+        if (errno != ENOENT) {
+            perror("shm_open");
+            exit(1);
+        }
+        usleep(100000);
+    }
+
+    while (segFileSize(fd) < sizeof(Br)) {
+        usleep(10000);
+    }
+    Br* br = mmap(NULL, sizeof(Br), PROT_READ, MAP_SHARED, fd, 0);
+    if (br == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    unsigned n;
+    while ((n = __atomic_load_n(&br->nstudents, __ATOMIC_ACQUIRE)) == 0 ||
+           segFileSize(fd) < segSize(n)) {
+        usleep(10000);
+    }
+    munmap(br, sizeof(Br));
+
+    br = mmap(NULL, segSize(n), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (br == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    return &br->snapshot;
+}
+
+//  частота опроса (10-100)
+// ./bathmon [hz]
+int main(int argc, char* argv[])
+{
+    int hz = DEFAULT_HZ;
+    if (argc >= 2) {
+        hz = atoi(argv[1]);
+    }
+    if (hz < MIN_HZ) hz = MIN_HZ;
+    if (hz > MAX_HZ) hz = MAX_HZ;
+
+    const char* name = getenv("BATH_SHM");
+    if (name == NULL) name = BATH_SHM_NAME;
+
+    printf("bathmon: ожидание сегмента %s, частота %d Гц\n", name, hz);
+    const BrSnapshot* snap = attach(name);
+
+    struct timespec period = { 0, 1000000000L / hz };
+    BrStats s;
+    readSnapshot(snap, &s);
+
+    unsigned long start = now_ns();
+    unsigned long prev_adm = s.admissions, prev_t = start;
+
+    while (1) {
+        readSnapshot(snap, &s);
+
+        unsigned long t = now_ns();
+        unsigned long idle = s.idle_ns;
+        if (s.idle_since_ns != 0 && t > s.idle_since_ns)
+            idle += t - s.idle_since_ns;
+
+        double rate = (t > prev_t) ? (s.admissions - prev_adm) / ((t - prev_t) / 1e9) : 0.0;
+
+        printf("%8.2f  %-8s занято %2u/%-2u серия %2u/%-2u  ждут м:%-3u ж:%-3u  "
+               "вошло %-6lu (%6.1f/с)  простой %.3f с\n",
+               (t - start) / 1e9,
+               stateName(s.state),
+               s.cabins_used, s.cabins_total,
+               s.streak, s.max_streak,
+               s.waiting_men, s.waiting_women,
+               s.admissions, rate,
+               idle / 1e9);
+        fflush(stdout);
+
+        if (s.finished)
+            break;
+
+        prev_adm = s.admissions;
+        prev_t = t;
+        nanosleep(&period, NULL);
+    }
+
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bathroom.h"
+
+/// @brief Опредение глобальной душевой
+Br* b;
+/// @brief Глобальное определние студентов
+St* students;
+/// @brief Кольца событий студентов (по одному на студента)
+EvRing* rings;
+
+/// @brief Запись события студента в его кольцо. Вызывается в критической
+/// секции: только копирование в память, без системных вызовов
+/// @param b ванная
+/// @param s студент
+/// @param type тип события
+void emitEvent(Br* b, St* s, EvType type)
+{
+    Event e = {
+        .ts_ns = now_ns(),
+        .studentID = s->studentID,
+        .pid = s->pid,
+        .type = type,
+        .sex = s->sex,
+        .timeForShower = s->timeForShower,
+        .cabins_used = b->cabins_used,
+        .cabins_total = b->cabins_total,
+        .streak = b->streak,
+        .max_streak = b->max_streak,
+        .waiting_men = b->waiting_men,
+        .waiting_women = b->waiting_women,
+    };
+    ringPush(&rings[s->studentID - 1], &e);
+}
+
+/// @brief Проверка доступности входа
+/// @param b ванная
+/// @param s студент
+/// @return
+bool canEnter(Br* b, St* s)
+{
+    pthread_mutex_lock(&b->dataMutex);
+
+    // все кабинки заняты
+    if (b->cabins_used == b->cabins_total) {
+        pthread_mutex_unlock(&b->dataMutex);
+        return false;
+    }
+
+    if (b->state == nobody) {
+        if (b->force_change && b->last_state == s->sex) {
+            // Если есть ожидающие противоположного пола – ждём, иначе пускаем
+            if ((s->sex == man && b->waiting_women > 0) ||
+                (s->sex == woman && b->waiting_men > 0)) {
+                    pthread_mutex_unlock(&b->dataMutex);
+                    return false;  // запрет тому же полу после серии
+            }
+            // Иначе сбрасываем force_change и пускаем
+            b->force_change = false;
+        }
+        pthread_mutex_unlock(&b->dataMutex);
+        return true;
+    }
+
+    // разный пол вместе находится не может
+    if (b->state != s->sex) {
+        pthread_mutex_unlock(&b->dataMutex);
+        return false;
+    }
+
+    // Справедливый вход
+    if (b->streak >= b->max_streak) {
+        // Приоритет противоположному полу, если они ждут
+        if (s->sex == man && b->waiting_women > 0)
+        {
+            pthread_mutex_unlock(&b->dataMutex);
+            return false;
+        }
+
+        if (s->sex == woman && b->waiting_men > 0)
+        {
+            pthread_mutex_unlock(&b->dataMutex);
+            return false;
+        }
+    }
+
+    pthread_mutex_unlock(&b->dataMutex);
+    return true;
+}
+
+/// @brief Вход в ванную
+/// @param b ванная
+/// @param s студент
+/// @return
+bool enterBathroom(Br *b, St *s)
+{
+    pthread_mutex_lock(&b->condMutex);
+
+    bool must_wait = !canEnter(b, s);
+
+    if (must_wait) {
+        if (s->sex == man) b->waiting_men++;
+        else b->waiting_women++;
+        publishSnapshot(b, false);
+    }
+
+    while (!canEnter(b,s)) {
+        // ожидание cond_broadcast
+        pthread_cond_wait(&b->cond, &b->condMutex);
+        s->wakeups++;
+    }
+
+    if (must_wait) {
+        if (s->sex == man) b->waiting_men--;
+        else b->waiting_women--;
+    }
+
+    if (b->state == nobody)
+    {
+        if (b->force_change && b->last_state != s->sex) {
+            b->force_change = false; 
+            emitEvent(b, s, ev_switch);
+        }
+        b->state = s->sex;
+        b->streak = 0;
+    }
+
+    if (b->cabins_used == 0) {
+        // конец простоя ванной
+        b->idle_ns += now_ns() - b->idle_since_ns;
+        b->idle_since_ns = 0;
+    }
+
+    if (b->admissions == 0) {
+        b->first_admit_ns = now_ns();
+    }
+
+    b->cabins_used++;
+    b->streak++;
+    b->admissions++;
+
+    if (b->last_proc >= 0) {
+        if (b->last_proc == s->proc) b->handoffs_intra++;
+        else b->handoffs_cross++;
+    }
+    b->last_proc = s->proc;
+
+    emitEvent(b, s, ev_enter);
+
+    if (b->streak == b->max_streak) {
+        emitEvent(b, s, ev_streak);
+    }
+
+    publishSnapshot(b, false);
+
+    pthread_mutex_unlock(&b->condMutex);
+
+    return true;
+}
+
+/// @brief Выход из ванной
+/// @param b ванная
+/// @param s студент
+void leaveBathroom(Br* b, St* s)
+{
+    pthread_mutex_lock(&b->condMutex);
+
+        pthread_mutex_lock(&b->dataMutex);
+
+        b->cabins_used--;
+
+        if (b->cabins_used == 0)
+        {
+            if (b->streak >= b->max_streak) {
+                b->last_state = b->state;  // запомнить пол
+                b->force_change = true;     // требовать смену
+            } else {
+                b->force_change = false;  // обычный выход, смена не требуется
+            }
+
+            b->state = nobody;
+            b->streak = 0;
+            // начало простоя ванной
+            b->idle_since_ns = now_ns();
+        }
+
+        emitEvent(b, s, ev_leave);
+
+        publishSnapshot(b, false);
+
+        pthread_mutex_unlock(&b->dataMutex);
+
+    // посылаем сигнал всем: место освободилось, кто сможет тот зайдет
+    pthread_cond_broadcast(&b->cond);
+
+    pthread_mutex_unlock(&b->condMutex);
+}
+
+/// @brief Функция процесса студента 
+/// @param arg
+/// @return
+void studentProcess (St* s) {
+
+    s->pid = getpid();
+    clock_gettime(CLOCK_MONOTONIC, &s->arrival);
+
+    enterBathroom(b,s);
+
+    clock_gettime(CLOCK_MONOTONIC, &s->enter);
+
+    struct timespec ts;
+    ts.tv_sec  = (time_t)s->timeForShower;
+    ts.tv_nsec = (long)((s->timeForShower - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+
+    leaveBathroom(b, s);
+
+    clock_gettime(CLOCK_MONOTONIC, &s->leave);
+}
+
+/// @brief Функция потока студента (гибридный режим)
+/// @param arg студент
+/// @return
+void* studentThread (void* arg) {
+    studentProcess((St*)arg);
+    return NULL;
+}
+
+/// @brief Рабочий процесс: T потоков-студентов против общей ванной
+/// @param first первый студент процесса
+/// @param threads количество потоков
+void workerProcess (St* first, int threads) {
+    if (threads == 1) {
+        studentProcess(first);
+        return;
+    }
+
+    // при отказе pthread_create студент выполняется прямо в процессе
+    pthread_t tid[threads];
+    bool started[threads];
+    for (int i = 0; i < threads; i++) {
+        started[i] = pthread_create(&tid[i], NULL, studentThread, &first[i]) == 0;
+        if (!started[i]) {
+            studentThread(&first[i]);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(tid[i], NULL);
+        }
+    }
+}
+
+/// @brief Подключение к существующему сегменту ванной (рабочий процесс,
+/// запущенный через exec, не наследует отображения родителя)
+/// @param name имя сегмента
+/// @return false при ошибке
+bool bathAttach(const char* name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        close(fd);
+        return false;
+    }
+
+    b = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (b == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    students = (St*)((char*)b + segStudentsOffset());
+    rings = (EvRing*)((char*)b + segRingsOffset(b->nstudents));
+    return true;
+}
@@ -0,0 +1,270 @@
+#ifndef BATHROOM_H
+#define BATHROOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+/// @brief Имя сегмента разделяемой памяти по умолчанию (можно переопределить
+/// переменной окружения BATH_SHM)
+#define BATH_SHM_NAME "/networkos_bathroom"
+
+/// @brief Ёмкость кольца событий одного студента (степень двойки).
+/// Студент пишет не более 4 событий: смена пола, вход, серия, выход
+#define RING_CAP 8
+
+typedef enum {
+    nobody,
+    man,
+    woman,
+} Sex;
+
+typedef struct timespec Time;
+
+/// @brief Моментальный снимок состояния ванной для внешних наблюдателей
+typedef struct {
+    unsigned cabins_total;
+    unsigned cabins_used;
+    Sex state;
+
+    unsigned streak;
+    unsigned max_streak;
+
+    unsigned waiting_men;
+    unsigned waiting_women;
+
+    // всего впущено студентов с начала работы
+    unsigned long admissions;
+    // накопленное время простоя (все кабинки свободны), нс
+    unsigned long idle_ns;
+    // начало текущего простоя, нс (0 - ванная занята)
+    unsigned long idle_since_ns;
+
+    // симуляция завершена
+    bool finished;
+} BrStats;
+
+/// @brief Снимок под seqlock: писатель никогда не ждёт читателей,
+/// читатель повторяет чтение, если попал на запись (нечётный seq)
+typedef struct {
+    unsigned seq;
+    BrStats data;
+} BrSnapshot;
+
+typedef struct {
+    pthread_mutex_t dataMutex;
+    pthread_cond_t cond;
+
+    pthread_mutex_t condMutex;
+
+    unsigned cabins_total;
+    unsigned cabins_used;
+    Sex state;
+    Sex last_state;
+    bool force_change;
+
+    unsigned waiting_men;
+    unsigned waiting_women;
+
+    // сколько последовательно зашло человек одного пола
+    unsigned streak;
+    unsigned max_streak;
+
+    unsigned long admissions;
+    unsigned long idle_ns;
+    unsigned long idle_since_ns;
+    // время первого входа, нс (замер скорости запуска)
+    unsigned long first_admit_ns;
+
+    // число студентов в сегменте (за ванной лежат St[n] и EvRing[n])
+    unsigned nstudents;
+
+    // процесс последнего вошедшего и счётчики передач ванной
+    // между студентами разных процессов / одного процесса
+    int last_proc;
+    unsigned long handoffs_cross;
+    unsigned long handoffs_intra;
+
+    BrSnapshot snapshot;
+} Br;
+
+typedef struct
+{
+    int studentID;
+    pid_t pid;
+    // номер рабочего процесса (гибридный режим процессы x потоки)
+    int proc;
+    // сколько раз студент просыпался в ожидании
+    unsigned wakeups;
+
+    Sex sex;
+    float timeForShower;
+
+    Time arrival;
+    Time enter;
+    Time leave;
+} St;
+
+typedef enum {
+    ev_switch,  // смена пола выполнена
+    ev_enter,   // студент вошёл
+    ev_streak,  // достигнута максимальная серия
+    ev_leave,   // студент вышел
+} EvType;
+
+/// @brief Событие студента (пишется в критической секции без системных вызовов)
+typedef struct {
+    unsigned long ts_ns;
+    int studentID;
+    pid_t pid;
+    EvType type;
+    Sex sex;
+    float timeForShower;
+
+    unsigned short cabins_used;
+    unsigned short cabins_total;
+    unsigned short streak;
+    unsigned short max_streak;
+    unsigned short waiting_men;
+    unsigned short waiting_women;
+} Event;
+
+/// @brief Кольцо событий с одним писателем (студент) и одним читателем (родитель).
+/// head и tail на разных кэш-линиях, чтобы не мешать друг другу
+typedef struct {
+    unsigned head __attribute__((aligned(64)));
+    unsigned dropped;
+    unsigned tail __attribute__((aligned(64)));
+    Event ev[RING_CAP];
+} EvRing;
+
+/// @brief Смещение массива студентов в сегменте
+static inline size_t segStudentsOffset(void)
+{
+    return (sizeof(Br) + 63) & ~(size_t)63;
+}
+
+/// @brief Смещение массива колец событий в сегменте
+/// @param n число студентов
+static inline size_t segRingsOffset(unsigned n)
+{
+    return (segStudentsOffset() + n * sizeof(St) + 63) & ~(size_t)63;
+}
+
+/// @brief Полный размер сегмента для n студентов
+/// @param n число студентов
+static inline size_t segSize(unsigned n)
+{
+    return segRingsOffset(n) + n * sizeof(EvRing);
+}
+
+/// @brief Запись события в кольцо (только писатель). Никогда не ждёт:
+/// при переполнении событие отбрасывается и учитывается в dropped
+/// @param r кольцо
+/// @param e событие
+/// @return false, если кольцо заполнено
+static inline bool ringPush(EvRing* r, const Event* e)
+{
+    unsigned head = r->head;
+    unsigned tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == RING_CAP) {
+        r->dropped++;
+        return false;
+    }
+
+    r->ev[head & (RING_CAP - 1)] = *e;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/// @brief Чтение события из кольца (только читатель)
+/// @param r кольцо
+/// @param e событие
+/// @return false, если кольцо пусто
+static inline bool ringPop(EvRing* r, Event* e)
+{
+    unsigned tail = r->tail;
+    unsigned head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    if (tail == head)
+        return false;
+
+    *e = r->ev[tail & (RING_CAP - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/// @brief Общие ванная, студенты и кольца (bathroom.c)
+extern Br* b;
+extern St* students;
+extern EvRing* rings;
+
+void emitEvent(Br* b, St* s, EvType type);
+bool canEnter(Br* b, St* s);
+bool enterBathroom(Br* b, St* s);
+void leaveBathroom(Br* b, St* s);
+void studentProcess(St* s);
+void* studentThread(void* arg);
+void workerProcess(St* first, int threads);
+bool bathAttach(const char* name);
+
+/// @brief Текущее время CLOCK_MONOTONIC в наносекундах
+static inline unsigned long now_ns(void)
+{
+    Time t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long)t.tv_sec * 1000000000UL + (unsigned long)t.tv_nsec;
+}
+
+/// @brief Публикация снимка. Вызывается только под condMutex,
+/// поэтому писатель всегда один
+/// @param b ванная
+/// @param finished признак завершения симуляции
+static inline void publishSnapshot(Br* b, bool finished)
+{
+    BrStats s = {
+        .cabins_total = b->cabins_total,
+        .cabins_used = b->cabins_used,
+        .state = b->state,
+        .streak = b->streak,
+        .max_streak = b->max_streak,
+        .waiting_men = b->waiting_men,
+        .waiting_women = b->waiting_women,
+        .admissions = b->admissions,
+        .idle_ns = b->idle_ns,
+        .idle_since_ns = b->idle_since_ns,
+        .finished = finished,
+    };
+
+    unsigned seq = b->snapshot.seq;
+    __atomic_store_n(&b->snapshot.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&b->snapshot.data, &s, sizeof(s));
+
+    __atomic_store_n(&b->snapshot.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/// @brief Чтение снимка без блокировок
+/// @param snap снимок (может быть отображён только на чтение)
+/// @param out копия данных
+static inline void readSnapshot(const BrSnapshot* snap, BrStats* out)
+{
+    unsigned s1, s2;
+    do {
+        s1 = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1)
+            continue;
+
+        memcpy(out, (const void*)&snap->data, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        s2 = __atomic_load_n(&snap->seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+}
+
+#endif
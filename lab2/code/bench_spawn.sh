@@ -0,0 +1,15 @@
+#!/bin/sh
+# Сравнение способов запуска процессов студентов.
+# Переменные: COUNTS - число студентов, BALLAST - балласт родителя в МиБ,
+# CABINS/STREAK - с широкой ванной очередь не копится и замер
+# показывает именно стоимость запуска
+COUNTS=${COUNTS:-"1000 5000 10000 50000"}
+BALLAST=${BALLAST:-0}
+CABINS=${CABINS:-64}
+STREAK=${STREAK:-64}
+
+for n in $COUNTS; do
+    for s in fork vfork spawn clone; do
+        ./task.z -B -S $s -M $BALLAST $n $CABINS $STREAK | tail -n 1
+    done
+done
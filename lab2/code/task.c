@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -7,9 +8,19 @@
 #include <linux/time.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <spawn.h>
+#include <signal.h>
+#include <string.h>
+
+#include "bathroom.h"
 
 #define MAX_STREAK_FOR_STATE 5
-#define MAX_STUDENTS 100
 #define BATHROOM_CAPACITY 4
 
 #define COLOR_YELLOW "\033[33m"
@@ -17,51 +28,41 @@
 #define COLOR_RED   "\033[31m"
 #define COLOR_RESET "\033[0m"
 
-typedef enum {
-    nobody,
-    man,
-    woman,
-} Sex;
-
-typedef struct {
-    pthread_mutex_t dataMutex;
-    pthread_cond_t cond;
-
-    pthread_mutex_t condMutex;
-
-    unsigned cabins_total;
-    unsigned cabins_used;
-    Sex state;
-    Sex last_state;
-    bool force_change;
+/// @brief Параметры из командной строки
+unsigned cabinsArg = BATHROOM_CAPACITY;
+unsigned streakArg = MAX_STREAK_FOR_STATE;
+/// @brief Файл бинарной трассы событий (-o)
+const char* traceFile = NULL;
+/// @brief Гибридный режим: процессов (-P) и потоков-студентов в каждом (-T)
+int procsArg = 0;
+int threadsArg = 0;
 
-    unsigned waiting_men;
-    unsigned waiting_women;
-
-    // сколько последовательно зашло человек одного пола
-    unsigned streak;
-    unsigned max_streak;
-} Br;
+/// @brief Способ запуска процессов студентов (-S)
+typedef enum {
+    spawn_fork,     // fork() с копированием таблиц страниц родителя
+    spawn_vfork,    // vfork() + exec рабочего процесса worker.z
+    spawn_posix,    // posix_spawn() рабочего процесса worker.z
+    spawn_clone,    // clone() без CLONE_VM
+} SpawnMode;
 
-typedef struct timespec Time;
+const char* spawnNames[] = { "fork", "vfork", "spawn", "clone" };
 
-typedef struct
-{
-    int studentID;
+SpawnMode spawnArg = spawn_fork;
+/// @brief Замер скорости запуска (-B): нулевое время в душе, без журнала
+bool benchArg = false;
+/// @brief Балласт родителя в МиБ (-M), чтобы увидеть цену fork()
+unsigned ballastArg = 0;
 
-    Sex sex;
-    float timeForShower;
+/// @brief Путь к worker.z (рядом с task.z или BATH_WORKER)
+char workerPath[PATH_MAX];
 
-    Time arrival;
-    Time enter;
-    Time leave;
-} St;
+/// @brief Стек для clone(): без CLONE_VM каждый потомок получает свою
+/// копию, поэтому один буфер годится для всех
+static char cloneStack[64 * 1024] __attribute__((aligned(16)));
 
+extern char** environ;
 
-/// @brief Опредение глобальной душевой
-Br* b;
-/// @brief Глобальное определние студентов
-St* students;
+const char* shmName();
 
 /// @brief Определение разницы времени между a и b
 /// @param a timespec
@@ -72,198 +73,239 @@ double timespec_diff(Time a, Time b)
     return (b.tv_sec - a.tv_sec) +  (b.tv_nsec - a.tv_nsec) / 1e9;
 }
 
-/// @brief Проверка доступности входа
-/// @param b ванная
-/// @param s студент
+/// @brief Точка входа потомка clone()
+/// @param arg первый студент
 /// @return
-bool canEnter(Br* b, St* s)
+int cloneEntry(void* arg)
 {
-    pthread_mutex_lock(&b->dataMutex);
+    workerProcess((St*)arg, 1);
+    return 0;
+}
 
-    // все кабинки заняты
-    if (b->cabins_used == b->cabins_total) {
-        pthread_mutex_unlock(&b->dataMutex);
-        return false;
+/// @brief Поиск worker.z рядом с исполняемым файлом
+void findWorker()
+{
+    const char* env = getenv("BATH_WORKER");
+    if (env != NULL) {
+        snprintf(workerPath, sizeof(workerPath), "%s", env);
+        return;
     }
 
-    if (b->state == nobody) {
-        if (b->force_change && b->last_state == s->sex) {
-            // Если есть ожидающие противоположного пола – ждём, иначе пускаем
-            if ((s->sex == man && b->waiting_women > 0) ||
-                (s->sex == woman && b->waiting_men > 0)) {
-                    pthread_mutex_unlock(&b->dataMutex);
-                    return false;  // запрет тому же полу после серии
-            }
-            // Иначе сбрасываем force_change и пускаем
-            b->force_change = false;
-        }
-        pthread_mutex_unlock(&b->dataMutex);
-        return true;
-    }
+    ssize_t len = readlink("/proc/self/exe", workerPath, sizeof(workerPath) - 1);
+    if (len < 0) len = 0;
+    workerPath[len] = '\0';
 
-    // разный пол вместе находится не может
-    if (b->state != s->sex) {
-        pthread_mutex_unlock(&b->dataMutex);
-        return false;
-    }
+    char* slash = strrchr(workerPath, '/');
+    size_t dir = slash ? (size_t)(slash - workerPath + 1) : 0;
+    snprintf(workerPath + dir, sizeof(workerPath) - dir, "worker.z");
+}
 
-    // Справедливый вход
-    if (b->streak >= b->max_streak) {
-        // Приоритет противоположному полу, если они ждут
-        if (s->sex == man && b->waiting_women > 0)
-        {
-            pthread_mutex_unlock(&b->dataMutex);
-            return false;
+/// @brief Запуск рабочего процесса выбранным способом
+/// @param first индекс первого студента процесса
+/// @param threads потоков в процессе
+/// @return pid потомка или -1 (errno установлен)
+pid_t launchWorker(int first, int threads)
+{
+    pid_t pid = -1;
+
+    // аргументы exec готовятся заранее: после vfork() потомку можно
+    // только exec или _exit
+    char firstStr[16], threadsStr[16];
+    snprintf(firstStr, sizeof(firstStr), "%d", first);
+    snprintf(threadsStr, sizeof(threadsStr), "%d", threads);
+    char* wargv[] = { workerPath, (char*)shmName(), firstStr, threadsStr, NULL };
+
+    switch (spawnArg) {
+    case spawn_fork:
+        pid = fork();
+        if (pid == 0) {
+            workerProcess(&students[first], threads);
+            exit(0);
         }
-
-        if (s->sex == woman && b->waiting_men > 0)
-        {
-            pthread_mutex_unlock(&b->dataMutex);
-            return false;
+        break;
+    case spawn_vfork:
+        pid = vfork();
+        if (pid == 0) {
+            execv(workerPath, wargv);
+            _exit(127);
         }
+        break;
+    case spawn_posix: {
+        int err = posix_spawn(&pid, workerPath, NULL, NULL, wargv, environ);
+        if (err != 0) {
+            errno = err;
+            pid = -1;
+        }
+        break;
+    }
+    case spawn_clone:
+        pid = clone(cloneEntry, cloneStack + sizeof(cloneStack), SIGCHLD, &students[first]);
+        break;
     }
 
-    pthread_mutex_unlock(&b->dataMutex);
-    return true;
+    return pid;
 }
 
-/// @brief Вход в ванную
-/// @param b ванная
-/// @param s студент
-/// @return
-bool enterBathroom(Br *b, St *s)
+/// @brief Статистика по рабочим процессам гибридного режима
+/// @param procs количество процессов
+/// @param threads потоков в процессе
+/// @param total_time общее время работы
+void printProcStats(int procs, int threads, double total_time)
 {
-    pthread_mutex_lock(&b->condMutex);
-
-    bool must_wait = !canEnter(b, s);
-
-    if (must_wait) {
-        if (s->sex == man) b->waiting_men++;
-        else b->waiting_women++;
+    printf(COLOR_RESET"\tПроцесс  студ.  ср.ожидание  макс.ожидание  пробуждений/студ.\n");
+    for (int p = 0; p < procs; p++) {
+        double sum = 0.0, max = 0.0;
+        unsigned long wakeups = 0;
+        for (int t = 0; t < threads; t++) {
+            St* s = &students[p * threads + t];
+            double wait = timespec_diff(s->arrival, s->enter);
+            sum += wait;
+            if (wait > max) max = wait;
+            wakeups += s->wakeups;
+        }
+        printf(COLOR_RESET"\t%7d  %5d  %11.3f  %13.3f  %17.2f\n",
+               p, threads, sum / threads, max, (double)wakeups / threads);
     }
 
-    while (!canEnter(b,s)) {
-        // ожидание cond_broadcast
-        pthread_cond_wait(&b->cond, &b->condMutex);
-    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double throughput = b->admissions / total_time;
+    printf(COLOR_RESET"Пропускная способность: %.2f входов/с, на ядро: %.2f (ядер: %ld)\n",
+           throughput, throughput / cores, cores);
+    printf(COLOR_RESET"Передачи ванной: между процессами %lu, внутри процесса %lu\n",
+           b->handoffs_cross, b->handoffs_intra);
+}
 
-    if (must_wait) {
-        if (s->sex == man) b->waiting_men--;
-        else b->waiting_women--;
-    }
+/// @brief Собранные родителем события всех студентов
+Event* eventLog;
+size_t eventCount, eventCap;
 
-    if (b->state == nobody)
-    {
-        if (b->force_change && b->last_state != s->sex) {
-            b->force_change = false; 
-            printf(COLOR_YELLOW"\t>>> СМЕНА ПОЛА ВЫПОЛНЕНА: Теперь в ванной %s <<<\n",
-                   s->sex == man ? "мужчины" : "женщины");
+/// @brief Перенос событий из колец студентов в общий журнал родителя
+/// @param studLen количество студентов
+void drainRings(int studLen)
+{
+    Event e;
+    for (int i = 0; i < studLen; i++) {
+        while (ringPop(&rings[i], &e)) {
+            if (eventCount == eventCap) {
+                eventCap = eventCap ? eventCap * 2 : 256;
+                eventLog = realloc(eventLog, eventCap * sizeof(Event));
+            }
+            eventLog[eventCount++] = e;
         }
-        b->state = s->sex;
-        b->streak = 0;
     }
-
-    b->cabins_used++;
-    b->streak++;
-
-    printf(COLOR_GREEN"%4d. Студент (%-5s) [PID %d] in, время %5.3f. Занято: %d/%d streak: %d/%d \twait_m: %d wait_w: %d\n",
-        s->studentID,
-        s->sex == man ? "man":"woman",
-        getpid(),
-        s->timeForShower,
-        b->cabins_used, b->cabins_total,
-        b->streak, b->max_streak,
-        b->waiting_men, b->waiting_women
-    );
-
-    if (b->streak == b->max_streak) {
-        printf(COLOR_YELLOW"\t>>> СМЕНА: Достигнут максимальный streak (%d) для %6s! <<<\n", 
-               b->max_streak,
-               s->sex == man ? "мужчин" : "женщин");
-    }
-
-    pthread_mutex_unlock(&b->condMutex);
-
-    return true;
 }
 
-/// @brief Выход из ванной
-/// @param b ванная
-/// @param s студент
-void leaveBathroom(Br* b, St* s)
+/// @brief Сравнение событий по времени (при равенстве - по порядку в серии)
+int eventCmp(const void* pa, const void* pb)
 {
-    pthread_mutex_lock(&b->condMutex);
-
-        pthread_mutex_lock(&b->dataMutex);
-
-        b->cabins_used--;
-
-        if (b->cabins_used == 0)
-        {
-            if (b->streak >= b->max_streak) {
-                b->last_state = b->state;  // запомнить пол
-                b->force_change = true;     // требовать смену
-            } else {
-                b->force_change = false;  // обычный выход, смена не требуется
-            }
-
-            b->state = nobody;
-            b->streak = 0;
-        }
+    const Event* a = pa;
+    const Event* c = pb;
+    if (a->ts_ns != c->ts_ns)
+        return a->ts_ns < c->ts_ns ? -1 : 1;
+    if (a->type != c->type)
+        return a->type < c->type ? -1 : 1;
+    return a->studentID - c->studentID;
+}
 
-        printf(COLOR_RED"%4d. Студент (%-5s) out. Занято: %d/%d\n",
-            s->studentID,
-            s->sex == man ? "man":"woman",
-            b->cabins_used, b->cabins_total
+/// @brief Вывод события в текстовый журнал
+/// @param e событие
+/// @param base_ns время начала симуляции
+void printEvent(const Event* e, unsigned long base_ns)
+{
+    double t = (e->ts_ns - base_ns) / 1e9;
+
+    switch (e->type) {
+    case ev_switch:
+        printf(COLOR_YELLOW"[%8.3f]\t>>> СМЕНА ПОЛА ВЫПОЛНЕНА: Теперь в ванной %s <<<\n",
+               t, e->sex == man ? "мужчины" : "женщины");
+        break;
+    case ev_enter:
+        printf(COLOR_GREEN"[%8.3f] %4d. Студент (%-5s) [PID %d] in, время %5.3f. Занято: %d/%d streak: %d/%d \twait_m: %d wait_w: %d\n",
+            t,
+            e->studentID,
+            e->sex == man ? "man":"woman",
+            e->pid,
+            e->timeForShower,
+            e->cabins_used, e->cabins_total,
+            e->streak, e->max_streak,
+            e->waiting_men, e->waiting_women
         );
-
-        pthread_mutex_unlock(&b->dataMutex);
-
-    // посылаем сигнал всем: место освободилось, кто сможет тот зайдет
-    pthread_cond_broadcast(&b->cond);
-
-    pthread_mutex_unlock(&b->condMutex);
+        break;
+    case ev_streak:
+        printf(COLOR_YELLOW"[%8.3f]\t>>> СМЕНА: Достигнут максимальный streak (%d) для %6s! <<<\n",
+               t, e->max_streak,
+               e->sex == man ? "мужчин" : "женщин");
+        break;
+    case ev_leave:
+        printf(COLOR_RED"[%8.3f] %4d. Студент (%-5s) out. Занято: %d/%d\n",
+            t,
+            e->studentID,
+            e->sex == man ? "man":"woman",
+            e->cabins_used, e->cabins_total
+        );
+        break;
+    }
 }
 
-/// @brief Функция процесса студента 
-/// @param arg
-/// @return
-void studentProcess (St* s) {
-
-    clock_gettime(CLOCK_MONOTONIC, &s->arrival);
-
-    enterBathroom(b,s);
-
-    clock_gettime(CLOCK_MONOTONIC, &s->enter);
-
-    struct timespec ts;
-    ts.tv_sec  = (time_t)s->timeForShower;
-    ts.tv_nsec = (long)((s->timeForShower - ts.tv_sec) * 1e9);
-    nanosleep(&ts, NULL);
+/// @brief Запись упорядоченной бинарной трассы: заголовок "BATHTRC1",
+/// число событий (uint64) и массив Event
+/// @param path путь к файлу
+void writeTrace(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        perror("trace");
+        return;
+    }
 
-    leaveBathroom(b, s);
+    unsigned long count = eventCount;
+    fwrite("BATHTRC1", 1, 8, f);
+    fwrite(&count, sizeof(count), 1, f);
+    fwrite(eventLog, sizeof(Event), eventCount, f);
+    fclose(f);
 
-    clock_gettime(CLOCK_MONOTONIC, &s->leave);
+    printf(COLOR_RESET"Трасса: %lu событий записано в %s\n", count, path);
 }
 
-void init();
+void init(int studLen);
 
 int random_number(int min_num, int max_num);
 
 int initVarsFromCMD(int argc, char *argv[]);
 
+//       27           3          5
+// [-o trace.bin] [-P procs -T threads] [-S fork|vfork|spawn|clone] [-B] [-M MiB]
+//     students_count cabins_total streak
 int main(int argc, char* argv[]){
     srand((unsigned)time(NULL));
 
-    init();
-
     int studLen, m = 0;
     studLen = initVarsFromCMD(argc, argv);
+    findWorker();
 
-    if (studLen == 0) {
-        studLen = random_number(10, 40);
+    if (ballastArg > 0) {
+        // балласт в адресном пространстве родителя: fork() копирует его
+        // таблицы страниц для каждого потомка
+        size_t size = (size_t)ballastArg << 20;
+        memset(malloc(size), 1, size);
     }
 
+    // по умолчанию один процесс на студента, в гибридном режиме
+    // число студентов равно P * T
+    int procs, threads = 1;
+    if (procsArg > 0 && threadsArg > 0) {
+        procs = procsArg;
+        threads = threadsArg;
+        studLen = procs * threads;
+    } else {
+        if (studLen <= 0) {
+            studLen = random_number(10, 40);
+        }
+        procs = studLen;
+    }
+
+    init(studLen);
+
     // Инициализация студентов
     for (int i = 0; i < studLen; i++) {
         int rtime = random_number(2, 5);
@@ -275,40 +317,94 @@ int main(int argc, char* argv[]){
 
         students[i].timeForShower =
             (students[i].sex == woman) ? 2 * rtime : rtime;
+        if (benchArg)
+            students[i].timeForShower = 0;
         students[i].studentID = i + 1;
+        students[i].proc = i / threads;
     }
 
+    publishSnapshot(b, false);
+
     printf(COLOR_RESET
         "\tНачало: студентов - %d, студентов - %d, студенток - %d, кабинок - %d, " \
         "максимальная серия - %d\n",
         studLen, m, studLen - m,
         b->cabins_total, b->max_streak);
+    if (threads > 1) {
+        printf(COLOR_RESET"\tГибридный режим: процессов - %d, потоков в процессе - %d\n",
+               procs, threads);
+    }
+    if (spawnArg == spawn_clone && threads > 1) {
+        fprintf(stderr, "clone без CLONE_VM поддерживает только -T 1\n");
+        exit(1);
+    }
+    fflush(stdout);
 
-    pid_t pids[MAX_STUDENTS];
-    Time total_begin, total_end;
+    Time total_begin, total_end, launch_end;
 
     clock_gettime(CLOCK_MONOTONIC, &total_begin);
 
-    // Создание дочерних процессов
-    for (int i = 0; i < studLen; i++) {
-        pids[i] = fork();
-        if (pids[i] == 0) {
-            // дочерный процесс
-            studentProcess(&students[i]);
-            exit(0);
-        } else if(pids[i] < 0) {
-            perror("fork");
+    // Создание дочерних процессов; завершившихся забираем сразу,
+    // чтобы десятки тысяч зомби не упёрлись в лимит процессов
+    int alive = 0;
+    pid_t pid;
+    for (int i = 0; i < procs; i++) {
+        while (launchWorker(i * threads, threads) < 0) {
+            if (errno == EAGAIN && alive > 0 && waitpid(-1, NULL, 0) > 0) {
+                alive--;
+                continue;
+            }
+            perror(spawnNames[spawnArg]);
             exit(1);
         }
+        alive++;
+
+        while (alive > 0 && (pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+            alive--;
+        }
     }
 
-    // ожидание завершения процессов
-    for (int i = 0; i < studLen; i++) {
-        waitpid(pids[i], NULL, 0);
+    clock_gettime(CLOCK_MONOTONIC, &launch_end);
+
+    // ожидание завершения процессов; по ходу забираем события из колец,
+    // сами студенты в stdout не пишут
+    struct timespec poll = { 0, 10000000L };
+    while (alive > 0) {
+        drainRings(studLen);
+
+        bool reaped = false;
+        while (alive > 0 && (pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+            alive--;
+            reaped = true;
+        }
+        if (!reaped)
+            nanosleep(&poll, NULL);
     }
+    drainRings(studLen);
 
     clock_gettime(CLOCK_MONOTONIC, &total_end);
 
+    // слияние колец по времени в единый журнал
+    qsort(eventLog, eventCount, sizeof(Event), eventCmp);
+    unsigned long base_ns = (unsigned long)total_begin.tv_sec * 1000000000UL + total_begin.tv_nsec;
+    if (!benchArg) {
+        for (size_t i = 0; i < eventCount; i++) {
+            printEvent(&eventLog[i], base_ns);
+        }
+    }
+
+    unsigned dropped = 0;
+    for (int i = 0; i < studLen; i++) {
+        dropped += rings[i].dropped;
+    }
+    if (dropped > 0) {
+        printf(COLOR_RESET"Потеряно событий (переполнение колец): %u\n", dropped);
+    }
+
+    if (traceFile != NULL) {
+        writeTrace(traceFile);
+    }
+
     printf(COLOR_RESET
         "\t==============Завершение==============\n");
 
@@ -331,27 +427,68 @@ int main(int argc, char* argv[]){
            total_wait / studLen);
     printf(COLOR_RESET"Утилизация: %.2f%%\n", utilization);
 
+    if (threads > 1) {
+        printProcStats(procs, threads, total_time);
+    }
+
+    if (benchArg) {
+        double launch_time = timespec_diff(total_begin, launch_end);
+        printf(COLOR_RESET"Запуск (%s): процессов %d за %.3f с, %.0f процессов/с, "
+               "до первого входа %.3f мс, событий %zu\n",
+               spawnNames[spawnArg], procs, launch_time, procs / launch_time,
+               (b->first_admit_ns - base_ns) / 1e6, eventCount);
+    }
+
+    // финальный снимок для наблюдателей (bathmon)
+    pthread_mutex_lock(&b->condMutex);
+    publishSnapshot(b, true);
+    pthread_mutex_unlock(&b->condMutex);
+
     // Очистка
     pthread_mutex_destroy(&b->dataMutex);
     pthread_mutex_destroy(&b->condMutex);
     pthread_cond_destroy(&b->cond);
-    munmap(b, sizeof(Br));
-    munmap(students, sizeof(St) * MAX_STUDENTS);
+    munmap(b, segSize(studLen));
+    shm_unlink(shmName());
+    free(eventLog);
 
     return 0;
 }
 
-void init() {
-    // Ванная в разделяемой памяти
-    b = mmap(NULL, sizeof(Br),
+/// @brief Имя сегмента с ванной (BATH_SHM или имя по умолчанию)
+/// @return
+const char* shmName() {
+    const char* name = getenv("BATH_SHM");
+    return name ? name : BATH_SHM_NAME;
+}
+
+/// @brief Создание сегмента: ванная, студенты и их кольца событий
+/// @param studLen количество студентов
+void init(int studLen) {
+    size_t size = segSize(studLen);
+
+    // Ванная в именованной разделяемой памяти, чтобы к ней мог
+    // подключиться монитор bathmon
+    int fd = shm_open(shmName(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        perror("shm_open");
+        exit(1);
+    }
+
+    b = mmap(NULL, size,
         PROT_READ | PROT_WRITE,
-        MAP_SHARED | MAP_ANON, -1, 0);
+        MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (b == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
 
-    // Студенты в разделяемой памяти
-    students = mmap(NULL, sizeof(St) * MAX_STUDENTS,
-                    PROT_READ | PROT_WRITE,
-                    MAP_SHARED | MAP_ANON,
-                    -1, 0);
+    // Студенты и кольца в том же сегменте сразу за ванной
+    students = (St*)((char*)b + segStudentsOffset());
+    rings = (EvRing*)((char*)b + segRingsOffset(studLen));
+    b->nstudents = studLen;
 
     pthread_mutexattr_t attr;
     pthread_mutexattr_init(&attr);
@@ -366,7 +503,7 @@ void init() {
     pthread_mutex_init(&b->condMutex, &attr);
     pthread_cond_init(&b->cond, &cattr);
 
-    b->cabins_total = BATHROOM_CAPACITY;
+    b->cabins_total = cabinsArg;
 
     b->cabins_used = 0;
     b->state = nobody;
@@ -376,7 +513,13 @@ void init() {
     b->waiting_men = 0;
     b->waiting_women = 0;
     b->streak = 0;
-    b->max_streak = MAX_STREAK_FOR_STATE;
+    b->max_streak = streakArg;
+
+    b->admissions = 0;
+    b->last_proc = -1;
+    b->idle_ns = 0;
+    b->idle_since_ns = now_ns();
+    b->snapshot.seq = 0;
 
     pthread_mutexattr_destroy(&attr);
     pthread_condattr_destroy(&cattr);
@@ -392,17 +535,61 @@ int random_number(int min_num, int max_num) {
 }
 
 int initVarsFromCMD(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "+o:P:T:S:BM:")) != -1) {
+        switch (opt) {
+        case 'o':
+            traceFile = optarg;
+            break;
+        case 'P':
+            procsArg = atoi(optarg);
+            break;
+        case 'T':
+            threadsArg = atoi(optarg);
+            break;
+        case 'S':
+            for (spawnArg = spawn_fork; spawnArg <= spawn_clone; spawnArg++) {
+                if (strcmp(optarg, spawnNames[spawnArg]) == 0)
+                    break;
+            }
+            if (spawnArg > spawn_clone) {
+                fprintf(stderr, "Неизвестный способ запуска: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'B':
+            benchArg = true;
+            break;
+        case 'M':
+            ballastArg = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Использование: %s [-o trace.bin] [-P процессы -T потоки] "
+                    "[-S fork|vfork|spawn|clone] [-B] [-M МиБ] [студенты [кабинки [серия]]]\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    // гибридный режим задается только парой -P и -T
+    if ((procsArg > 0) != (threadsArg > 0)) {
+        fprintf(stderr, "-P и -T задаются вместе\n");
+        exit(1);
+    }
+
+    argc -= optind;
+    argv += optind;
+
     int studCounts = 0;
-    if (argc >= 2) {
-        studCounts = atoi(argv[1]);
+    if (argc >= 1) {
+        studCounts = atoi(argv[0]);
     }
 
-    if (argc >= 3) {
-        b->cabins_total = atoi(argv[2]);
+    if (argc >= 2) {
+        cabinsArg = atoi(argv[1]);
     }
 
-    if (argc >= 4) {
-        b->max_streak = atoi(argv[3]);
+    if (argc >= 3) {
+        streakArg = atoi(argv[2]);
     }
 
     return studCounts;
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bathroom.h"
+
+// Рабочий процесс для запуска через vfork+exec и posix_spawn:
+// подключается к сегменту родителя и отыгрывает своих студентов
+//
+// ./worker.z shm_name first_student threads
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        fprintf(stderr, "Использование: %s <сегмент> <первый студент> <потоки>\n", argv[0]);
+        return 1;
+    }
+
+    if (!bathAttach(argv[1])) {
+        return 1;
+    }
+
+    int first = atoi(argv[2]);
+    int threads = atoi(argv[3]);
+    if (first < 0 || threads <= 0 || (unsigned)(first + threads) > b->nstudents) {
+        fprintf(stderr, "worker: неверный диапазон студентов %d+%d\n", first, threads);
+        return 1;
+    }
+
+    workerProcess(&students[first], threads);
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#!/bin/sh
+# Сравнение ввода-вывода серверов: select, epoll и io_uring (сборка с
+# USE_IO_URING). select - ключ запуска (server_ -s, server -L) той же
+# сборки, что и epoll.
+# server_.c: client_ --open дает заданную частоту JOIN через CONNS
+# соединений; сервер в конце отчитывается о системных вызовах циклов на
+# один допуск.
+# server.c: client --load через CONNS соединений по REQS запросов CMD
+# (повтор одной команды отвечается из кэша); системные вызовы реактора
+# на команду - из строки статуса сервера.
+# Переменные: CONNS - число соединений, RATE - JOIN в секунду, SEC -
+# длительность замера, BATH_MS - время в ванной, LOOPS - циклов событий
+# сервера, ADDR - адрес для config.txt (127.0.0.1 или unix), REQS/CMD -
+# запросы client --load.
+# Закрытые TCP-соединения клиента остаются в TIME_WAIT: несколько замеров
+# по 10000 подряд могут исчерпать локальные порты, тогда - ADDR=unix.
+CONNS=${CONNS:-"1000 5000 10000"}
+RATE=${RATE:-2000}
+SEC=${SEC:-3}
+BATH_MS=${BATH_MS:-0.2}
+LOOPS=${LOOPS:-2}
+ADDR=${ADDR:-127.0.0.1}
+REQS=${REQS:-2}
+CMD=${CMD:-"10 verbose=0 scale=0.001 seed=1"}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:-"-Wall -Wextra -pthread"}
+
+set -e
+$CC $CFLAGS -o bench_epoll.z server_.c
+$CC $CFLAGS -DUSE_IO_URING -o bench_uring.z server_.c
+$CC $CFLAGS -o bench_client_.z client_.c
+$CC $CFLAGS -o bench_server_epoll.z server.c -lm
+$CC $CFLAGS -DUSE_IO_URING -o bench_server_uring.z server.c -lm
+$CC $CFLAGS -o bench_client.z client.c -lm
+set +e
+
+cp config.txt config.txt.bak 2>/dev/null
+trap 'mv config.txt.bak config.txt 2>/dev/null; kill $srv 2>/dev/null; rm -f bench_*.z bench_server.log' EXIT
+trap 'exit 1' INT TERM
+echo $ADDR > config.txt
+
+# соединений на поток клиента: поток на ядро
+cpus=$(nproc)
+ulimit -n 65536 2>/dev/null
+
+echo "=== server_.c: допуск при открытой нагрузке $RATE JOIN/с ==="
+for n in $CONNS; do
+    per=$(( (n + cpus - 1) / cpus ))
+    for io in select epoll uring; do
+        case $io in
+            select) ./bench_epoll.z -t $LOOPS -s > /dev/null 2>&1 & ;;
+            *) ./bench_$io.z -t $LOOPS > /dev/null 2>&1 & ;;
+        esac
+        srv=$!
+        sleep 0.5
+        printf "%-6s %6d соединений: " $io $((per * cpus))
+        ./bench_client_.z --open $RATE $SEC $BATH_MS $per |
+            awk '/^Допуск/ { getline; p50 = $6; p99 = $10 }
+                 /^Системных вызовов/ { calls = $(NF - 2); sub(/\(/, "", calls) }
+                 END { printf "p50 %s мс, p99 %s мс, вызовов на допуск %s\n", p50, p99, calls }'
+        kill $srv; wait $srv 2>/dev/null
+        # кольцо io_uring ядро освобождает после выхода процесса: порт
+        # слушающего сокета занят еще какое-то время
+        sleep 1
+    done
+done
+
+# server.c: адрес - аргумент client, unix - локальный сокет
+echo "=== server.c: $REQS запросов \"$CMD\" на соединение ==="
+for n in $CONNS; do
+    for io in select epoll uring; do
+        case $io in
+            select) stdbuf -oL ./bench_server_epoll.z -q -L > bench_server.log 2>&1 & ;;
+            *) stdbuf -oL ./bench_server_$io.z -q > bench_server.log 2>&1 & ;;
+        esac
+        srv=$!
+        sleep 0.5
+        printf "%-6s %6d соединений: " $io $n
+        p99=$(./bench_client.z --load -n $n -m $REQS -e "$CMD" $ADDR |
+            awk '/^Задержка до завершения/ { getline; print $10 }')
+        # итог реактора печатается в строке статуса раз в 5 секунд
+        sleep 5.5
+        kill $srv; wait $srv 2>/dev/null
+        calls=$(awk '/^Реактор/ { v = $(NF - 3) } END { print v }' bench_server.log)
+        printf "p99 %s мс, вызовов на команду %s\n" "$p99" "$calls"
+        sleep 1
+    done
+done
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Сравнение TCP (петлевой интерфейс) и локального сокета AF_UNIX.
+# server_.c: открытая нагрузка client_ --open, задержка допуска при
+# заданной частоте; server.c: client --load, запросов/с и задержки.
+# Переменные: RATES - частоты JOIN в секунду, SEC - длительность замера,
+# BATH_MS - время в ванной, LOOPS - циклов событий server_, REPEAT - повторы,
+# CONNS/REQS/CMD - соединения, запросы и команда для client --load
+RATES=${RATES:-"1000 5000 10000"}
+SEC=${SEC:-3}
+BATH_MS=${BATH_MS:-0.2}
+LOOPS=${LOOPS:-2}
+REPEAT=${REPEAT:-2}
+CONNS=${CONNS:-20}
+REQS=${REQS:-20}
+CMD=${CMD:-"10 verbose=0 scale=0.001"}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:-"-Wall -Wextra -pthread"}
+
+set -e
+$CC $CFLAGS -o bench_server_.z server_.c
+$CC $CFLAGS -o bench_client_.z client_.c
+$CC $CFLAGS -o bench_server.z server.c -lm
+$CC $CFLAGS -o bench_client.z client.c -lm
+set +e
+
+# client_ читает адрес сервера из config.txt - сохраняем и восстанавливаем
+cp config.txt config.txt.bak 2>/dev/null
+trap 'mv config.txt.bak config.txt 2>/dev/null; kill $srv 2>/dev/null; rm -f bench_*.z' EXIT
+trap 'exit 1' INT TERM
+
+echo "=== server_.c: допуск при открытой нагрузке ==="
+./bench_server_.z -t $LOOPS > /dev/null 2>&1 &
+srv=$!
+sleep 0.5
+for rate in $RATES; do
+    for i in $(seq $REPEAT); do
+        for addr in 127.0.0.1 unix; do
+            echo $addr > config.txt
+            printf "%-9s %6s/с: " $addr $rate
+            ./bench_client_.z --open $rate $SEC $BATH_MS | grep -A1 "^Допуск" | tail -n 1
+        done
+    done
+done
+kill $srv; wait $srv 2>/dev/null
+
+echo "=== server.c: $CONNS соединений x $REQS запросов \"$CMD\" ==="
+./bench_server.z -q > /dev/null 2>&1 &
+srv=$!
+sleep 0.5
+for i in $(seq $REPEAT); do
+    for addr in 127.0.0.1 unix; do
+        echo "--- $addr"
+        ./bench_client.z --load -n $CONNS -m $REQS -e "$CMD" $addr | grep -A1 "^Время\|^Задержка до завершения" | grep -v "^--\|^Задержка до первого"
+    done
+done
@@ -3,10 +3,19 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "proto.h"
+#include "hist.h"
 
 // ============================================
 // НАСТРОЙКИ ПОДКЛЮЧЕНИЯ К СЕРВЕРУ
@@ -14,6 +23,7 @@
 #define PORT 5050                   // Порт сервера (должен совпадать с сервером)
 #define BUFFER_SIZE 1024            // Размер буфера для приема данных
 #define SERVER_IP "127.0.0.1"       // IP-адрес сервера (по умолчанию localhost)
+#define UNIX_PATH "/tmp/lab4_server.sock"   // Адрес "unix" или "unix:путь" - локальный сокет
 
 // ============================================
 // ЦВЕТОВЫЕ КОДЫ ДЛЯ КОНСОЛИ
@@ -21,8 +31,33 @@
 #define COLOR_CYAN    "\033[36m"
 #define COLOR_GREEN   "\033[32m"
 #define COLOR_YELLOW  "\033[33m"
+#define COLOR_RED     "\033[31m"
 #define COLOR_RESET   "\033[0m"
 
+/**
+ * @brief Подключение к серверу через локальный сокет AF_UNIX
+ * @param path - путь сокета сервера
+ * @return дескриптор сокета или -1 при ошибке
+ */
+int connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("Ошибка создания сокета");
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("Ошибка подключения к серверу");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
 /**
  * @brief Функция для установки TCP-соединения с сервером
  * @param ip_address - IP-адрес сервера в строковом формате
@@ -35,6 +70,11 @@
  * 3. Подключение к серверу (connect)
  */
 int connect_to_server(const char* ip_address, int port) {
+    // "unix" или "unix:путь" вместо IP - сервер на этой же машине
+    if (strncmp(ip_address, "unix", 4) == 0) {
+        return connect_unix(ip_address[4] == ':' ? ip_address + 5 : UNIX_PATH);
+    }
+
     int sock = 0;
     struct sockaddr_in serv_addr;
     
@@ -166,7 +206,7 @@ void client_loop(int sock) {
         // ============================================
         // Если сервер прислал "SERVER_READY" - запрашиваем данные у пользователя
         if (strstr(buffer, "SERVER_READY") != NULL) {
-            printf(COLOR_CYAN"\nВведите количество студентов (1-100): "COLOR_RESET);
+            printf(COLOR_CYAN"\nВведите количество студентов (N [cabins=K streak=S seed=X dist=.. arrive=.. verbose=V scale=F], dorm N - общее общежитие): "COLOR_RESET);
             
             // Чтение команды из консоли
             if (fgets(command, BUFFER_SIZE, stdin) != NULL) {
@@ -202,17 +242,574 @@ void client_loop(int sock) {
     }
 }
 
+// ============================================
+// ДВОИЧНЫЙ РЕЖИМ (--bin)
+// ============================================
+
+/**
+ * @brief Прием ровно len байт
+ * @param sock - дескриптор сокета
+ * @param buf - буфер
+ * @param len - сколько байт принять
+ * @return 0 при успехе, -1 при ошибке или закрытии соединения
+ */
+int recv_exact(int sock, void* buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(sock, (char*)buf + got, len - got, 0);
+        if (n > 0) {
+            got += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Прием одного кадра
+ * @param sock - дескриптор сокета
+ * @param type - тип кадра
+ * @param payload - буфер нагрузки (PROTO_MAX_PAYLOAD + 1 байт)
+ * @param len - длина нагрузки
+ * @return 0 при успехе, -1 при ошибке
+ *
+ * Границы сообщений задает заголовок, а не содержимое: кадры, склеенные
+ * или разорванные TCP, собираются корректно.
+ */
+int recv_frame(int sock, uint8_t* type, uint8_t* payload, uint32_t* len) {
+    uint8_t hdr[PROTO_HDR_SIZE];
+    if (recv_exact(sock, hdr, sizeof(hdr)) < 0) {
+        return -1;
+    }
+    if (proto_parse(hdr, sizeof(hdr), type, len) < 0) {
+        fprintf(stderr, "Неверный кадр: версия %d, длина %u\n", hdr[5], proto_get32(hdr));
+        return -1;
+    }
+    if (*len > 0 && recv_exact(sock, payload, *len) < 0) {
+        return -1;
+    }
+    payload[*len] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Отправка кадра
+ * @param sock - дескриптор сокета
+ * @param type - тип кадра
+ * @param data - нагрузка
+ * @param len - длина нагрузки
+ * @return 0 при успехе, -1 при ошибке
+ */
+int send_frame(int sock, uint8_t type, const void* data, uint32_t len) {
+    uint8_t frame[PROTO_HDR_SIZE + BUFFER_SIZE];
+    if (len > BUFFER_SIZE) {
+        return -1;
+    }
+    proto_header(frame, type, len);
+    memcpy(frame + PROTO_HDR_SIZE, data, len);
+    if (send(sock, frame, PROTO_HDR_SIZE + len, MSG_NOSIGNAL) < 0) {
+        perror("Ошибка отправки");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Вывод события ванной в том же виде, что и текстовый режим
+ * @param e - событие
+ */
+void print_event(const ProtoEvent* e) {
+    const char* who = e->sex == PROTO_SEX_MAN ? "man" : "woman";
+    switch (e->kind) {
+    case PE_ENTER:
+        printf(COLOR_GREEN"%4d. Студент (%-5s) in, время (%5.3f). Занято: %d/%d Серия: %d/%d \twait_m: %d wait_w: %d\n"COLOR_RESET,
+               e->student_id, who, e->shower_ms / 1000.0,
+               e->cabins_used, e->cabins_total, e->streak, e->max_streak,
+               e->waiting_men, e->waiting_women);
+        break;
+    case PE_LEAVE:
+        printf(COLOR_RED"%4d. Student (%-5s) out. Занято: %d/%d\n"COLOR_RESET,
+               e->student_id, who, e->cabins_used, e->cabins_total);
+        break;
+    case PE_SWITCH:
+        printf(COLOR_YELLOW"\t>>> СМЕНА ПОЛА ВЫПОЛНЕНА: Теперь в ванной %s <<<\n"COLOR_RESET,
+               e->sex == PROTO_SEX_MAN ? "мужчины" : "женщины");
+        break;
+    case PE_STREAK:
+        printf(COLOR_YELLOW"\t>>> СМЕНА: Достигнута максимальная серия (%d) для %6s! <<<\n"COLOR_RESET,
+               e->max_streak, e->sex == PROTO_SEX_MAN ? "мужчин" : "женщин");
+        break;
+    }
+}
+
+/**
+ * @brief Интерактивный цикл клиента в двоичном режиме
+ * @param sock - дескриптор сокета
+ *
+ * 1. Читает текстовое приветствие сервера (до перевода строки)
+ * 2. Запрашивает переход на кадры: "proto bin <версия>"
+ * 3. Дальше разбирает только кадры по типам
+ */
+void client_loop_bin(int sock) {
+    static uint8_t payload[PROTO_MAX_PAYLOAD + 1];
+    char command[BUFFER_SIZE];
+    int running = 1;
+
+    // Текстовое приветствие SERVER_READY
+    char ch;
+    do {
+        if (recv_exact(sock, &ch, 1) < 0) {
+            printf("Сервер закрыл соединение\n");
+            return;
+        }
+    } while (ch != '\n');
+
+    snprintf(command, sizeof(command), "%s %d\n", PROTO_HELLO_CMD, PROTO_VERSION);
+    if (send_message(sock, command) < 0) {
+        return;
+    }
+
+    printf(COLOR_GREEN"Подключено к серверу. Ожидание команды...\n"COLOR_RESET);
+
+    while (running) {
+        uint8_t type;
+        uint32_t len;
+        if (recv_frame(sock, &type, payload, &len) < 0) {
+            printf("Сервер закрыл соединение\n");
+            break;
+        }
+
+        switch (type) {
+        case FR_HELLO:
+            printf(COLOR_GREEN"Двоичный протокол, версия %d\n"COLOR_RESET, len > 0 ? payload[0] : 0);
+            break;
+        case FR_READY:
+            printf(COLOR_CYAN"\nВведите количество студентов (N [cabins=K streak=S seed=X dist=.. arrive=.. verbose=V scale=F], dorm N - общее общежитие): "COLOR_RESET);
+            if (fgets(command, BUFFER_SIZE, stdin) == NULL) {
+                running = 0;
+                break;
+            }
+            command[strcspn(command, "\n")] = 0;
+            if (strcmp(command, "exit") == 0 || strcmp(command, "quit") == 0) {
+                printf("Отключение от сервера...\n");
+                running = 0;
+            } else if (send_frame(sock, FR_CMD, command, strlen(command)) < 0) {
+                running = 0;
+            }
+            break;
+        case FR_EVENT:
+            if (len == PROTO_EVENT_SIZE) {
+                ProtoEvent e;
+                proto_event_decode(payload, &e);
+                print_event(&e);
+            }
+            break;
+        case FR_START:
+        case FR_STATS:
+            if (len == PROTO_STATS_SIZE) {
+                ProtoStats s;
+                proto_stats_decode(payload, &s);
+                if (type == FR_START) {
+                    printf("\tНачало: студентов - %d, кабинок - %d, максимальная серия - %d%s\n",
+                           s.students, s.cabins_total, s.max_streak,
+                           s.shared ? " (общее общежитие)" : "");
+                } else {
+                    printf("\t=======================Завершение======================\n");
+                    printf("Среднее время ожидания: %f\n", s.avg_wait_us / 1e6);
+                    printf("Утилизация: %.2f%%\n", s.utilization_bp / 100.0);
+                    printf("Время симуляции: %.3f с\n", s.total_ms / 1000.0);
+                }
+            }
+            break;
+        case FR_TEXT:
+            printf("%s", (char*)payload);
+            break;
+        case FR_ERROR:
+            printf("%s", (char*)payload);
+            printf(COLOR_YELLOW"\nПолучена ошибка. Попробуйте снова.\n"COLOR_RESET);
+            break;
+        case FR_BUSY:
+            printf(COLOR_YELLOW"Сервер занят, повторите через %u с\n"COLOR_RESET,
+                   len >= 4 ? proto_get32(payload) : 0);
+            break;
+        case FR_DROPPED:
+            printf("\t[пропущено рассылок: %u]\n", len >= 4 ? proto_get32(payload) : 0);
+            break;
+        case FR_DONE:
+        case FR_BYE:
+            printf("%s", (char*)payload);
+            printf(COLOR_YELLOW"\nСеанс завершен. Можно подключиться снова.\n"COLOR_RESET);
+            running = 0;
+            break;
+        default:
+            // Неизвестные типы пропускаем: длина известна из заголовка
+            break;
+        }
+    }
+}
+
+// ============================================
+// НАГРУЗОЧНЫЙ РЕЖИМ (--load)
+// ============================================
+// N соединений в одном потоке на epoll, каждое по очереди отправляет
+// M запросов из набора команд (файл сценария или сетка параметров).
+// Используются кадры: граница каждого ответа известна точно, поэтому
+// задержки меряются от отправки команды до первого вывода симуляции
+// (FR_START/FR_EVENT) и до FR_DONE.
+
+#define LOAD_MAX_EVENTS 256
+#define LOAD_MAX_CMDS 4096
+#define LOAD_IDLE_SEC 60            // Без единого кадра столько секунд - прерываем
+
+typedef enum {
+    LS_GREETING,        // текстовое приветствие до перевода строки
+    LS_HELLO,           // ждем FR_HELLO
+    LS_IDLE,            // ждем FR_READY
+    LS_REQUEST,         // запрос отправлен
+    LS_FINISHED,
+} LoadPhase;
+
+typedef struct {
+    int fd;
+    LoadPhase phase;
+    uint8_t* in;                    // Принятые, еще не разобранные байты
+    size_t in_len;
+    size_t in_cap;
+    int sent;                       // Запросов отправлено
+    int cmd;                        // Команда текущего запроса
+    double t_send;
+    int got_first;
+} LoadSession;
+
+// Итог по одной команде набора
+typedef struct {
+    char text[BUFFER_SIZE];
+    unsigned long done;
+    unsigned long busy;
+    unsigned long errors;
+    Hist complete;
+} LoadCmd;
+
+double load_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Чтение сценария: одна команда в строке, # - комментарий
+ * @param path - файл
+ * @param cmds - набор команд
+ * @return число команд или -1
+ */
+int load_read_script(const char* path, LoadCmd* cmds) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror("Файл сценария");
+        return -1;
+    }
+    char line[BUFFER_SIZE];
+    int n = 0;
+    while (n < LOAD_MAX_CMDS && fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n#")] = '\0';
+        char* s = line + strspn(line, " \t");
+        if (*s != '\0') {
+            snprintf(cmds[n++].text, BUFFER_SIZE, "%s", s);
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+/**
+ * @brief Сетка параметров: декартово произведение списков
+ * @param grid - "students=10,50 cabins=2,4 dist=lab,exp:3 ..."
+ * @param cmds - набор команд
+ * @return число команд или -1
+ *
+ * Ключ students (или n) задает число студентов, остальные ключи
+ * передаются серверу как есть: "<N> ключ=значение ...".
+ */
+int load_build_grid(const char* grid, LoadCmd* cmds) {
+    char keys[16][32], vals[16][16][32];
+    int nvals[16], nkeys = 0, students_key = -1;
+    char buf[BUFFER_SIZE];
+    snprintf(buf, sizeof(buf), "%s", grid);
+
+    char* save = NULL;
+    for (char* tok = strtok_r(buf, " ", &save); tok != NULL; tok = strtok_r(NULL, " ", &save)) {
+        char* eq = strchr(tok, '=');
+        if (eq == NULL || nkeys == 16) {
+            fprintf(stderr, "Неверная сетка: '%s' (нужно ключ=значение,значение)\n", tok);
+            return -1;
+        }
+        *eq = '\0';
+        snprintf(keys[nkeys], sizeof(keys[nkeys]), "%s", tok);
+        if (strcmp(tok, "students") == 0 || strcmp(tok, "n") == 0) {
+            students_key = nkeys;
+        }
+        nvals[nkeys] = 0;
+        char* vsave = NULL;
+        for (char* v = strtok_r(eq + 1, ",", &vsave); v != NULL && nvals[nkeys] < 16;
+             v = strtok_r(NULL, ",", &vsave)) {
+            snprintf(vals[nkeys][nvals[nkeys]++], 32, "%s", v);
+        }
+        nkeys++;
+    }
+    if (students_key < 0) {
+        fprintf(stderr, "В сетке нет students=...\n");
+        return -1;
+    }
+
+    // Перебор как счетчик со смешанным основанием
+    int idx[16] = {0}, n = 0;
+    while (n < LOAD_MAX_CMDS) {
+        char* out = cmds[n].text;
+        int len = snprintf(out, BUFFER_SIZE, "%s", vals[students_key][idx[students_key]]);
+        for (int k = 0; k < nkeys; k++) {
+            if (k != students_key) {
+                len += snprintf(out + len, BUFFER_SIZE - len, " %s=%s", keys[k], vals[k][idx[k]]);
+            }
+        }
+        n++;
+
+        int k = 0;
+        while (k < nkeys && ++idx[k] == nvals[k]) {
+            idx[k++] = 0;
+        }
+        if (k == nkeys) {
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Нагрузочный прогон
+ * @param ip - адрес сервера
+ * @param conns - число соединений
+ * @param per_conn - запросов на соединение
+ * @param cmds - набор команд (раздаются по кругу)
+ * @param ncmds - размер набора
+ * @return 0 при успехе
+ */
+int load_run(const char* ip, int conns, int per_conn, LoadCmd* cmds, int ncmds) {
+    LoadSession* ss = calloc(conns, sizeof(LoadSession));
+    int ep = epoll_create1(0);
+    int active = 0, next_cmd = 0;
+    unsigned long done = 0, busy = 0, errors = 0, broken = 0, events = 0;
+    Hist first, complete;
+    hist_init(&first);
+    hist_init(&complete);
+
+    printf(COLOR_CYAN"Нагрузка: %d соединений x %d запросов, команд в наборе: %d\n"COLOR_RESET,
+           conns, per_conn, ncmds);
+
+    double t0 = load_now();
+    for (int i = 0; i < conns; i++) {
+        int fd = connect_to_server(ip, PORT);
+        if (fd < 0) {
+            broken++;
+            ss[i].phase = LS_FINISHED;
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ss[i].fd = fd;
+        ss[i].phase = LS_GREETING;
+        ss[i].in_cap = 4096;
+        ss[i].in = malloc(ss[i].in_cap);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+        active++;
+    }
+    double t_conn = load_now();
+
+    struct epoll_event evs[LOAD_MAX_EVENTS];
+    while (active > 0) {
+        int n = epoll_wait(ep, evs, LOAD_MAX_EVENTS, LOAD_IDLE_SEC * 1000);
+        if (n == 0) {
+            fprintf(stderr, "Нет ответа %d с: активных соединений %d\n", LOAD_IDLE_SEC, active);
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int k = 0; k < n; k++) {
+            LoadSession* s = &ss[evs[k].data.u32];
+            bool closed = false;
+
+            // Чтение всего доступного
+            while (1) {
+                if (s->in_len == s->in_cap) {
+                    s->in_cap *= 2;
+                    s->in = realloc(s->in, s->in_cap);
+                }
+                ssize_t r = recv(s->fd, s->in + s->in_len, s->in_cap - s->in_len, 0);
+                if (r > 0) {
+                    s->in_len += r;
+                } else {
+                    closed = r == 0 || (errno != EAGAIN && errno != EINTR);
+                    if (r < 0 && errno == EINTR) continue;
+                    break;
+                }
+            }
+
+            // Разбор: приветствие - строка, дальше кадры
+            size_t pos = 0;
+            while (s->phase != LS_FINISHED) {
+                if (s->phase == LS_GREETING) {
+                    uint8_t* nl = memchr(s->in + pos, '\n', s->in_len - pos);
+                    if (nl == NULL) break;
+                    pos = nl - s->in + 1;
+                    char hello[32];
+                    snprintf(hello, sizeof(hello), "%s %d\n", PROTO_HELLO_CMD, PROTO_VERSION);
+                    send(s->fd, hello, strlen(hello), MSG_NOSIGNAL);
+                    s->phase = LS_HELLO;
+                    continue;
+                }
+
+                uint8_t type;
+                uint32_t len;
+                int rc = proto_parse(s->in + pos, s->in_len - pos, &type, &len);
+                if (rc < 0) {
+                    closed = true;
+                    break;
+                }
+                if (rc == 0) break;
+                pos += PROTO_HDR_SIZE + len;
+                double now = load_now();
+                uint64_t us = (uint64_t)((now - s->t_send) * 1e6);
+
+                switch (type) {
+                case FR_HELLO:
+                    s->phase = LS_IDLE;
+                    break;
+                case FR_READY:
+                    if (s->phase == LS_REQUEST) {
+                        break;      // приглашение после ответа "Принято"
+                    }
+                    if (s->sent == per_conn) {
+                        s->phase = LS_FINISHED;
+                        break;
+                    }
+                    s->cmd = next_cmd++ % ncmds;
+                    s->sent++;
+                    s->got_first = 0;
+                    s->phase = LS_REQUEST;
+                    s->t_send = load_now();
+                    if (send_frame(s->fd, FR_CMD, cmds[s->cmd].text, strlen(cmds[s->cmd].text)) < 0) {
+                        closed = true;
+                    }
+                    break;
+                case FR_START:
+                case FR_EVENT:
+                    events += type == FR_EVENT;
+                    if (s->phase == LS_REQUEST && !s->got_first) {
+                        s->got_first = 1;
+                        hist_record(&first, us);
+                    }
+                    break;
+                case FR_DONE:
+                    hist_record(&complete, us);
+                    hist_record(&cmds[s->cmd].complete, us);
+                    cmds[s->cmd].done++;
+                    done++;
+                    s->phase = LS_IDLE;
+                    break;
+                case FR_BUSY:
+                    cmds[s->cmd].busy++;
+                    busy++;
+                    s->phase = LS_IDLE;
+                    break;
+                case FR_ERROR:
+                    if (s->phase == LS_REQUEST) {
+                        cmds[s->cmd].errors++;
+                        errors++;
+                        s->phase = LS_IDLE;
+                    }
+                    break;
+                case FR_BYE:
+                    closed = true;
+                    break;
+                default:
+                    break;
+                }
+                if (closed) break;
+            }
+            memmove(s->in, s->in + pos, s->in_len - pos);
+            s->in_len -= pos;
+
+            if (closed || s->phase == LS_FINISHED) {
+                if (s->phase != LS_FINISHED) {
+                    broken++;
+                    s->phase = LS_FINISHED;
+                }
+                epoll_ctl(ep, EPOLL_CTL_DEL, s->fd, NULL);
+                close(s->fd);
+                active--;
+            }
+        }
+    }
+    double t_end = load_now();
+    double sec = t_end - t_conn;
+
+    // ============================================
+    // ОТЧЕТ
+    // ============================================
+    printf("\n=== НАГРУЗОЧНЫЙ РЕЖИМ: ИТОГ ===\n");
+    printf("Соединение %d клиентов: %.3f с\n", conns, t_conn - t0);
+    printf("Запросов: выполнено %lu, отклонено (BUSY) %lu, ошибок %lu, обрывов соединений %lu\n",
+           done, busy, errors, broken);
+    printf("Время %.3f с: %.2f запросов/с, %.0f событий/с\n",
+           sec, sec > 0 ? done / sec : 0.0, sec > 0 ? events / sec : 0.0);
+    hist_print(stdout, &first, "Задержка до первого вывода симуляции", 1000.0, "мс");
+    hist_print(stdout, &complete, "Задержка до завершения", 1000.0, "мс");
+
+    if (ncmds > 1) {
+        printf("\nПо командам (завершение, мс):\n");
+        // заголовок без %s-ширин: кириллица занимает по два байта
+        printf("  готово   BUSY  ошиб.        p50        p99       макс  команда\n");
+        for (int i = 0; i < ncmds; i++) {
+            const Hist* h = &cmds[i].complete;
+            printf("%8lu %6lu %6lu %10.3f %10.3f %10.3f  %s\n",
+                   cmds[i].done, cmds[i].busy, cmds[i].errors,
+                   hist_quantile(h, 0.5) / 1000.0, hist_quantile(h, 0.99) / 1000.0,
+                   h->total ? h->max / 1000.0 : 0.0, cmds[i].text);
+        }
+    }
+
+    for (int i = 0; i < conns; i++) {
+        free(ss[i].in);
+    }
+    free(ss);
+    close(ep);
+    return active == 0 ? 0 : 1;
+}
+
 /**
  * @brief Вывод справки по использованию
  */
 void print_help() {
     printf(COLOR_CYAN"\n=== Клиент лабораторной работы №4 ===\n"COLOR_RESET);
-    printf("Использование: ./client [IP_адрес]\n");
+    printf("Использование: ./client [--bin] [IP_адрес]\n");
+    printf("               ./client --load [-n соединений] [-m запросов] "
+           "[-f сценарий | -g сетка | -e команда] [IP_адрес]\n");
     printf("Примеры:\n");
     printf("  ./client              - подключиться к localhost:5050\n");
     printf("  ./client 192.168.1.1 - подключиться к указанному IP\n");
+    printf("  ./client unix         - локальный сокет %s (unix:путь - другой)\n", UNIX_PATH);
+    printf("  ./client --bin        - двоичный протокол с кадрами\n");
+    printf("  ./client --load -n 50 -m 10 -e \"10 verbose=0 scale=0.01\"\n");
+    printf("  ./client --load -n 8 -m 4 -g \"students=10,40 cabins=2,4 seed=1 scale=0.01\"\n");
     printf("\nКоманды:\n");
-    printf("  Число (1-100) - количество студентов для симуляции\n");
+    printf("  N [cabins=K streak=S seed=X dist=.. arrive=.. verbose=V scale=F]\n");
+    printf("                - симуляция N студентов (dorm N - общее общежитие)\n");
     printf("  exit/quit     - выход\n");
     printf(COLOR_CYAN"========================================\n\n"COLOR_RESET);
 }
@@ -223,18 +820,62 @@ void print_help() {
 int main(int argc, char *argv[]) {
     int sock = 0;
     const char* server_ip = SERVER_IP;
+    int binary = 0;
+    int load = 0, load_conns = 10, load_requests = 1;
+    const char* load_script = NULL;
+    const char* load_grid = NULL;
+    const char* load_cmd = "10 verbose=0";
     
     // ============================================
     // ОБРАБОТКА АРГУМЕНТОВ КОМАНДНОЙ СТРОКИ
     // ============================================
-    if (argc > 1) {
-        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_help();
             return 0;
         }
-        server_ip = argv[1];  // Использовать указанный IP
+        if (strcmp(argv[i], "--bin") == 0) {
+            binary = 1;     // Двоичный протокол с кадрами
+        } else if (strcmp(argv[i], "--load") == 0) {
+            load = 1;       // Нагрузочный режим без ввода с консоли
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            load_conns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            load_requests = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            load_script = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            load_grid = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            load_cmd = argv[++i];
+        } else {
+            server_ip = argv[i];  // Использовать указанный IP
+        }
     }
     
+    // ============================================
+    // НАГРУЗОЧНЫЙ РЕЖИМ
+    // ============================================
+    if (load) {
+        static LoadCmd cmds[LOAD_MAX_CMDS];
+        int ncmds = 1;
+        if (load_script != NULL) {
+            ncmds = load_read_script(load_script, cmds);
+        } else if (load_grid != NULL) {
+            ncmds = load_build_grid(load_grid, cmds);
+        } else {
+            snprintf(cmds[0].text, BUFFER_SIZE, "%s", load_cmd);
+        }
+        if (ncmds <= 0 || load_conns <= 0 || load_requests <= 0) {
+            fprintf(stderr, "Нет команд для нагрузки или неверные -n/-m\n");
+            return 1;
+        }
+        for (int i = 0; i < ncmds; i++) {
+            hist_init(&cmds[i].complete);
+        }
+        return load_run(server_ip, load_conns, load_requests, cmds, ncmds);
+    }
+
     print_help();
     
     // ============================================
@@ -254,7 +895,11 @@ int main(int argc, char *argv[]) {
     // ============================================
     // ЗАПУСК ИНТЕРАКТИВНОГО ЦИКЛА
     // ============================================
-    client_loop(sock);
+    if (binary) {
+        client_loop_bin(sock);
+    } else {
+        client_loop(sock);
+    }
     
     // ============================================
     // ЗАКРЫТИЕ СОЕДИНЕНИЯ
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,8 +6,17 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
 #include <time.h>
 #include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+
+#include "wire.h"
+#include "hist.h"
 
 #define COLOR_YELLOW "\033[33m"
 #define COLOR_GREEN "\033[32m"
@@ -14,31 +24,12 @@
 #define COLOR_RESET "\033[0m"
 
 #define PORT 8989
+#define UNIX_PATH "/tmp/lab4_server_.sock"   // адрес "unix" или "unix:путь"
+#define ARRIVAL_GAP_MS 100      // интервал прихода студентов
 
 typedef enum { MALE = 0, FEMALE = 1 } gender_t;
 #define GENDER_NAME(g) ((g) == MALE ? "мужчина" : "женщина")
 
-typedef enum { MSG_JOIN, MSG_LEAVE, MSG_UPDATE, MSG_STATS } msg_type_t;
-
-typedef struct {
-    msg_type_t type;
-    int id;
-    int gender;
-    long wait_start;
-    long bath_time;
-    int occupied;
-    int capacity;
-    int streak_gender;
-    int streak_used;
-    int remaining_male;
-    int remaining_female;
-    long total_wait_time;
-    long total_bath_time;
-    int entered_count;
-    int male_entered;
-    int female_entered;
-} msg_t;
-
 char server_ip[256] = "127.0.0.1";
 
 void read_config(const char *filename) {
@@ -58,30 +49,110 @@ void print_status(const msg_t *m, const char *action, int id, gender_t g) {
            m->streak_used, m->remaining_male, m->remaining_female);
 }
 
-void* student_thread(void *arg) {
-    int id = *((int*)arg);
-    free(arg);
+// Подключение к серверу через локальный сокет ("unix[:путь]" в config.txt)
+int connect_unix(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        printf("Ошибка создания сокета\n");
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        printf("Подключение к %s не удалось\n", path);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
 
-    gender_t gender = (rand() % 100 < 50) ? MALE : FEMALE;
-    int wash_time = 1 + rand() % 4;
+// Подключение к серверу, -1 при ошибке
+int connect_server(void) {
+    if (strncmp(server_ip, "unix", 4) == 0) {
+        return connect_unix(server_ip[4] == ':' ? server_ip + 5 : UNIX_PATH);
+    }
 
     int sock = 0;
     struct sockaddr_in serv_addr;
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         printf("Ошибка создания сокета\n");
-        return NULL;
+        return -1;
     }
 
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(PORT);
 
     if (inet_pton(AF_INET, server_ip, &serv_addr.sin_addr) <= 0) {
         printf("Неверный адрес/адрес недоступен\n");
-        return NULL;
+        close(sock);
+        return -1;
     }
 
     if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
         printf("Подключение не удалось\n");
+        close(sock);
+        return -1;
+    }
+
+    // Кадры мелкие: без TCP_NODELAY JOIN ждет подтверждения предыдущего
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Задержка JOIN -> разрешение по часам клиента (вместе с сетью):
+// клиент кладет в wait_start свое время в мкс, сервер его возвращает
+long rtt_sum_us, rtt_count;
+
+void note_admission(const msg_t *m) {
+    __atomic_fetch_add(&rtt_sum_us, (long)(now_sec() * 1e6) - m->wait_start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&rtt_count, 1, __ATOMIC_RELAXED);
+}
+
+// Отправка сообщения кадром wire.h
+int send_msg(int sock, const msg_t *msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t len = wire_encode(msg, frame);
+    return send(sock, frame, len, MSG_NOSIGNAL) == (ssize_t)len ? 0 : -1;
+}
+
+// Прием одного кадра целиком (блокирующий сокет): заголовок читается
+// по байту до конца varint длины, затем нагрузка одним вызовом
+int recv_msg(int sock, msg_t *msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t len = 0;
+    int n;
+    while ((n = wire_decode(frame, len, msg)) == 0) {
+        size_t need = 1;
+        if (len >= 4 && !(frame[len - 1] & 0x80)) {
+            uint64_t payload = 0;
+            int hl = wire_get_varint(frame + 3, len - 3, &payload);
+            need = 3 + hl + payload - len;
+        }
+        if (recv(sock, frame + len, need, MSG_WAITALL) != (ssize_t)need) {
+            return -1;
+        }
+        len += need;
+    }
+    return n < 0 ? -1 : 0;
+}
+
+void* student_thread(void *arg) {
+    int id = *((int*)arg);
+    free(arg);
+
+    gender_t gender = (rand() % 100 < 50) ? MALE : FEMALE;
+    int wash_time = 1 + rand() % 4;
+
+    int sock = connect_server();
+    if (sock < 0) {
         return NULL;
     }
 
@@ -89,78 +160,540 @@ void* student_thread(void *arg) {
     msg.type = MSG_JOIN;
     msg.id = id;
     msg.gender = gender;
-    msg.wait_start = (long)time(NULL);
+    msg.wait_start = (long)(now_sec() * 1e6);
 
-    send(sock, &msg, sizeof(msg), 0);
+    send_msg(sock, &msg);
 
-    recv(sock, &msg, sizeof(msg), 0);
+    if (recv_msg(sock, &msg) < 0) {
+        close(sock);
+        return NULL;
+    }
+    note_admission(&msg);
     print_status(&msg, "ВХОД", id, gender);
 
     sleep(wash_time);
 
     msg.type = MSG_LEAVE;
     msg.bath_time = wash_time;  // отправляем время в ванной
-    send(sock, &msg, sizeof(msg), 0);
+    send_msg(sock, &msg);
 
     close(sock);
 
-    long elapsed = wash_time;
-    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_lock(&lock);
-    printf(COLOR_RED"Студент %d (%s) вышел. Время в ванной: %ld сек.\n"COLOR_RESET, id, GENDER_NAME(gender), elapsed);
-    pthread_mutex_unlock(&lock);
+    printf(COLOR_RED"Студент %d (%s) вышел. Время в ванной: %d сек.\n"COLOR_RESET, id, GENDER_NAME(gender), wash_time);
 
     return NULL;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Использование: %s <число_студентов>\n", argv[0]);
-        return -1;
+// ============================================
+// МУЛЬТИПЛЕКСИРОВАННЫЙ РЕЖИМ (--mux K)
+// ============================================
+// Все студенты идут через K соединений в одном потоке: JOIN уходит
+// в момент прихода, разрешение находится по id в ответе, LEAVE
+// отправляется по таймеру. Число соединений и потоков не зависит
+// от числа студентов.
+
+typedef struct {
+    gender_t gender;
+    int wash_time;
+    int conn;               // соединение студента
+    double leave_at;        // момент выхода (после разрешения)
+} mux_student_t;
+
+// Куча выходов по leave_at: ближайший выход в heap[0]
+void heap_push(int *heap, int *len, const mux_student_t *st, int id) {
+    int i = (*len)++;
+    while (i > 0 && st[heap[(i - 1) / 2]].leave_at > st[id].leave_at) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
+    heap[i] = id;
+}
 
-    int total_students = atoi(argv[1]);
-    if (total_students <= 0) {
-        fprintf(stderr, "Некорректное число студентов: %s\n", argv[1]);
-        return -1;
+int heap_pop(int *heap, int *len, const mux_student_t *st) {
+    int top = heap[0], last = heap[--(*len)], i = 0;
+    while (2 * i + 1 < *len) {
+        int c = 2 * i + 1;
+        if (c + 1 < *len && st[heap[c + 1]].leave_at < st[heap[c]].leave_at) c++;
+        if (st[heap[c]].leave_at >= st[last].leave_at) break;
+        heap[i] = heap[c];
+        i = c;
     }
+    heap[i] = last;
+    return top;
+}
 
-    read_config("config.txt");
+/**
+ * Прогон всех студентов через nconn соединений
+ * server_leave: время в ванной уходит в JOIN, выход отмеряет сервер
+ * и присылает MSG_LEAVE; клиент LEAVE не отправляет
+ * Возвращает соединение для запроса статистики или -1
+ */
+int run_mux(int total, int nconn, bool server_leave) {
+    mux_student_t *st = calloc(total, sizeof(mux_student_t));
+    int *heap = malloc(total * sizeof(int));
+    int heap_len = 0;
+    struct pollfd pfd[nconn];
+    uint8_t (*rx)[WIRE_MAX_FRAME] = malloc(nconn * sizeof(*rx));
+    size_t rx_len[nconn];
+
+    for (int i = 0; i < total; i++) {
+        st[i].gender = (rand() % 100 < 50) ? MALE : FEMALE;
+        st[i].wash_time = 1 + rand() % 4;
+        st[i].conn = i % nconn;
+    }
+    for (int c = 0; c < nconn; c++) {
+        pfd[c].fd = connect_server();
+        pfd[c].events = POLLIN;
+        rx_len[c] = 0;
+        if (pfd[c].fd < 0) {
+            return -1;
+        }
+    }
+
+    double t0 = now_sec();
+    int arrived = 0, left = 0;
+    while (left < total) {
+        double now = now_sec();
+
+        // Приход: тот же темп, что и у потоков в обычном режиме
+        while (arrived < total && now >= t0 + arrived * ARRIVAL_GAP_MS / 1000.0) {
+            msg_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_JOIN;
+            msg.id = arrived;
+            msg.gender = st[arrived].gender;
+            msg.wait_start = (long)(now_sec() * 1e6);
+            if (server_leave) {
+                msg.service_us = st[arrived].wash_time * 1000000L;
+            }
+            send_msg(pfd[st[arrived].conn].fd, &msg);
+            arrived++;
+        }
+
+        // Выход по таймеру
+        while (heap_len > 0 && st[heap[0]].leave_at <= now) {
+            int id = heap_pop(heap, &heap_len, st);
+            msg_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_LEAVE;
+            msg.id = id;
+            msg.gender = st[id].gender;
+            msg.bath_time = st[id].wash_time;
+            send_msg(pfd[st[id].conn].fd, &msg);
+            printf(COLOR_RED"Студент %d (%s) вышел. Время в ванной: %d сек.\n"COLOR_RESET,
+                   id, GENDER_NAME(st[id].gender), st[id].wash_time);
+            left++;
+        }
+        if (left == total) {
+            break;
+        }
+
+        double wake = -1;
+        if (arrived < total) {
+            wake = t0 + arrived * ARRIVAL_GAP_MS / 1000.0;
+        }
+        if (heap_len > 0 && (wake < 0 || st[heap[0]].leave_at < wake)) {
+            wake = st[heap[0]].leave_at;
+        }
+        int timeout = wake < 0 ? -1 : (int)((wake - now) * 1000) + 1;
+
+        if (poll(pfd, nconn, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            return -1;
+        }
+
+        for (int c = 0; c < nconn; c++) {
+            if (!(pfd[c].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = recv(pfd[c].fd, rx[c] + rx_len[c], WIRE_MAX_FRAME - rx_len[c], 0);
+            if (n <= 0) {
+                printf("Сервер закрыл соединение\n");
+                return -1;
+            }
+            rx_len[c] += n;
+
+            // В буфере может быть несколько кадров и начало следующего
+            size_t pos = 0;
+            msg_t msg;
+            int len;
+            while ((len = wire_decode(rx[c] + pos, rx_len[c] - pos, &msg)) > 0) {
+                pos += len;
+
+                // Разрешение на вход конкретного студента
+                int id = msg.id;
+                if (msg.type == MSG_UPDATE && id >= 0 && id < total && st[id].leave_at == 0) {
+                    note_admission(&msg);
+                    print_status(&msg, "ВХОД", id, st[id].gender);
+                    st[id].leave_at = now_sec() + st[id].wash_time;
+                    if (!server_leave) {
+                        heap_push(heap, &heap_len, st, id);
+                    }
+                } else if (msg.type == MSG_LEAVE && server_leave && id >= 0 && id < total) {
+                    printf(COLOR_RED"Студент %d (%s) вышел. Время в ванной: %.3f сек.\n"COLOR_RESET,
+                           id, GENDER_NAME(st[id].gender), msg.service_us / 1e6);
+                    left++;
+                }
+            }
+            if (len < 0) {
+                printf("Неверный кадр от сервера\n");
+                return -1;
+            }
+            memmove(rx[c], rx[c] + pos, rx_len[c] - pos);
+            rx_len[c] -= pos;
+        }
+    }
 
-    pthread_t threads[total_students];
-    for (int i = 0; i < total_students; i++) {
-        int *id = malloc(sizeof(int));
-        *id = i;
-        pthread_create(&threads[i], NULL, student_thread, id);
-        usleep(100000);
+    for (int c = 1; c < nconn; c++) {
+        close(pfd[c].fd);
     }
+    free(st);
+    free(heap);
+    free(rx);
+    return pfd[0].fd;
+}
+
+// ============================================
+// ОТКРЫТАЯ НАГРУЗКА (--open)
+// ============================================
+// Студенты приходят по расписанию с заданным темпом независимо от
+// ответов сервера: момент JOIN студента k потока - start + k / темп.
+// Задержка считается от запланированного момента, а не от фактической
+// отправки, поэтому остановка сервера или клиента не прячет очередь
+// (поправка на coordinated omission). Выход отмеряет сервер (service_us
+// в JOIN). Поток на ядро, в каждом - неблокирующие соединения и ppoll.
+
+#define OPEN_CONNS 4            // соединений на поток по умолчанию
+#define OPEN_DRAIN_SEC 10       // ожидание ответов после последнего JOIN
 
-    for (int i = 0; i < total_students; i++) {
-        pthread_join(threads[i], NULL);
+typedef struct {
+    int fd;
+    uint8_t rx[WIRE_MAX_FRAME];
+    size_t rx_len;
+    uint8_t *tx;                // не ушедшие в сокет кадры
+    size_t tx_len, tx_cap;
+} open_conn_t;
+
+typedef struct {
+    pthread_t thread;
+    int index, nthreads;
+    double start;               // общий момент начала расписания
+    pthread_barrier_t *ready;   // все соединения установлены, start назначен
+    double rate;                // студентов/с этого потока
+    int count;                  // студентов этого потока
+    long service_us;
+    int nconn;
+
+    Hist admit;                 // мкс от запланированного JOIN до разрешения
+    Hist done;                  // мкс от запланированного JOIN до выхода
+    int sent, admitted, completed;
+    double max_lag;             // наибольшее отставание отправки от расписания
+    bool failed;
+} open_worker_t;
+
+void open_queue(open_conn_t *c, const msg_t *msg) {
+    if (c->tx_len + WIRE_MAX_FRAME > c->tx_cap) {
+        c->tx_cap = (c->tx_len + WIRE_MAX_FRAME) * 2;
+        c->tx = realloc(c->tx, c->tx_cap);
     }
+    c->tx_len += wire_encode(msg, c->tx + c->tx_len);
+}
 
-    // Запрос статистики
-    int sock = 0;
-    struct sockaddr_in serv_addr;
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
-    inet_pton(AF_INET, server_ip, &serv_addr.sin_addr);
-    if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) return -1;
+int open_flush(open_conn_t *c) {
+    while (c->tx_len > 0) {
+        ssize_t n = send(c->fd, c->tx, c->tx_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        memmove(c->tx, c->tx + n, c->tx_len - n);
+        c->tx_len -= n;
+    }
+    return 0;
+}
+
+void* open_worker(void *arg) {
+    open_worker_t *w = arg;
+    open_conn_t *conns = calloc(w->nconn, sizeof(open_conn_t));
+    struct pollfd *pfd = calloc(w->nconn, sizeof(struct pollfd));
+    unsigned seed = (unsigned)time(NULL) ^ (w->index * 2654435761u);
+
+    int opened = 0;
+    for (; opened < w->nconn; opened++) {
+        conns[opened].fd = connect_server();
+        if (conns[opened].fd < 0) {
+            w->failed = true;
+            break;
+        }
+        fcntl(conns[opened].fd, F_SETFL, fcntl(conns[opened].fd, F_GETFL) | O_NONBLOCK);
+        pfd[opened].fd = conns[opened].fd;
+    }
+    // Расписание начинается, когда подключились все потоки: установка
+    // тысяч соединений не должна съедать его начало
+    pthread_barrier_wait(w->ready);
+    pthread_barrier_wait(w->ready);
+    if (w->failed) {
+        w->nconn = opened;
+        goto out;
+    }
+
+    double end = w->start + w->count / w->rate + OPEN_DRAIN_SEC;
+    while (w->completed < w->count) {
+        double now = now_sec();
+        if (now > end) break;
+
+        // Все JOIN, чей момент наступил, даже если сервер не отвечает
+        while (w->sent < w->count && w->start + w->sent / w->rate <= now) {
+            double lag = now - (w->start + w->sent / w->rate);
+            if (lag > w->max_lag) w->max_lag = lag;
+
+            msg_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_JOIN;
+            msg.id = w->sent * w->nthreads + w->index;
+            msg.gender = rand_r(&seed) % 2;
+            msg.wait_start = (long)(now * 1e6);
+            msg.service_us = w->service_us;
+            open_queue(&conns[w->sent % w->nconn], &msg);
+            w->sent++;
+        }
+        for (int c = 0; c < w->nconn; c++) {
+            if (open_flush(&conns[c]) < 0) {
+                w->failed = true;
+                goto out;
+            }
+            pfd[c].events = POLLIN | (conns[c].tx_len > 0 ? POLLOUT : 0);
+        }
+
+        double wake = w->sent < w->count ? w->start + w->sent / w->rate : now + 0.1;
+        if (wake < now) wake = now;
+        struct timespec ts = { (time_t)(wake - now), (long)((wake - now - (time_t)(wake - now)) * 1e9) };
+        if (ppoll(pfd, w->nconn, &ts, NULL) < 0 && errno != EINTR) {
+            w->failed = true;
+            break;
+        }
+
+        for (int c = 0; c < w->nconn; c++) {
+            if (!(pfd[c].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            open_conn_t *oc = &conns[c];
+            ssize_t n = recv(oc->fd, oc->rx + oc->rx_len, sizeof(oc->rx) - oc->rx_len, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                w->failed = true;
+                goto out;
+            }
+            if (n < 0) continue;
+            oc->rx_len += n;
+
+            double t = now_sec();
+            size_t pos = 0;
+            msg_t msg;
+            int len;
+            while ((len = wire_decode(oc->rx + pos, oc->rx_len - pos, &msg)) > 0) {
+                pos += len;
+                int k = msg.id / w->nthreads;
+                if (msg.id % w->nthreads != w->index || k < 0 || k >= w->sent) continue;
+                uint64_t us = (uint64_t)((t - (w->start + k / w->rate)) * 1e6);
+                if (msg.type == MSG_UPDATE) {
+                    hist_record(&w->admit, us);
+                    w->admitted++;
+                } else if (msg.type == MSG_LEAVE) {
+                    hist_record(&w->done, us);
+                    w->completed++;
+                }
+            }
+            if (len < 0) {
+                w->failed = true;
+                goto out;
+            }
+            memmove(oc->rx, oc->rx + pos, oc->rx_len - pos);
+            oc->rx_len -= pos;
+        }
+    }
+
+out:
+    for (int c = 0; c < w->nconn; c++) {
+        close(conns[c].fd);
+        free(conns[c].tx);
+    }
+    free(conns);
+    free(pfd);
+    return NULL;
+}
+
+/**
+ * Открытая нагрузка: rate студентов/с в течение duration секунд
+ * Возвращает соединение для запроса статистики или -1
+ */
+int run_open(double rate, double duration, double service_ms, int nconn) {
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int total = (int)(rate * duration);
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > total) nthreads = total > 0 ? total : 1;
+
+    open_worker_t *w = calloc(nthreads, sizeof(open_worker_t));
+    pthread_barrier_t ready;
+    pthread_barrier_init(&ready, NULL, nthreads + 1);
+    for (int t = 0; t < nthreads; t++) {
+        w[t].index = t;
+        w[t].nthreads = nthreads;
+        w[t].ready = &ready;
+        w[t].rate = rate / nthreads;
+        w[t].count = total / nthreads + (t < total % nthreads);
+        w[t].service_us = (long)(service_ms * 1000);
+        w[t].nconn = nconn;
+        hist_init(&w[t].admit);
+        hist_init(&w[t].done);
+        pthread_create(&w[t].thread, NULL, open_worker, &w[t]);
+    }
+    pthread_barrier_wait(&ready);
+    double start = now_sec() + 0.1;
+    for (int t = 0; t < nthreads; t++) {
+        w[t].start = start + (double)t / rate;  // потоки чередуются в общем расписании
+    }
+    pthread_barrier_wait(&ready);
+
+    Hist admit, done;
+    hist_init(&admit);
+    hist_init(&done);
+    int sent = 0, admitted = 0, completed = 0;
+    double max_lag = 0;
+    bool failed = false;
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(w[t].thread, NULL);
+        hist_merge(&admit, &w[t].admit);
+        hist_merge(&done, &w[t].done);
+        sent += w[t].sent;
+        admitted += w[t].admitted;
+        completed += w[t].completed;
+        if (w[t].max_lag > max_lag) max_lag = w[t].max_lag;
+        failed |= w[t].failed;
+    }
+    double elapsed = now_sec() - start;
+
+    printf("\n=== ОТКРЫТАЯ НАГРУЗКА ===\n");
+    printf("Цель: %.0f студентов/с, %.1f с, в ванной %.3f мс; потоков %d, соединений %d\n",
+           rate, duration, service_ms, nthreads, nthreads * nconn);
+    printf("Отправлено JOIN: %d из %d, допущено %d, вышло %d, за %.3f с\n",
+           sent, total, admitted, completed, elapsed);
+    printf("Наибольшее отставание отправки от расписания: %.3f мс\n", max_lag * 1e3);
+    if (failed) {
+        printf("Часть соединений потеряна\n");
+    }
+    hist_print(stdout, &admit, "Допуск (от запланированного JOIN)", 1000, "мс");
+    hist_print(stdout, &done, "Выход (от запланированного JOIN)", 1000, "мс");
 
+    pthread_barrier_destroy(&ready);
+    free(w);
+    return connect_server();
+}
+
+// Среднее и квантили времен по полу из MSG_STATS
+void print_times(const char *title, const long *sum_ns, const uint32_t (*hist)[WIRE_LAT_BUCKETS], const msg_t *m) {
+    int count[2] = { m->male_entered, m->female_entered };
+    printf("%s:\n", title);
+    for (int g = 0; g < 2; g++) {
+        if (count[g] == 0) continue;
+        printf("  %s: среднее %.3f мс, p50 <= %.3f мс, p99 <= %.3f мс\n",
+               g == MALE ? "мужчины" : "женщины", sum_ns[g] / 1e6 / count[g],
+               wire_lat_quantile(hist[g], 0.5) / 1e3, wire_lat_quantile(hist[g], 0.99) / 1e3);
+    }
+}
+
+// Запрос MSG_STATS и печать статистики сервера; закрывает sock
+int print_server_stats(int sock) {
     msg_t msg;
+    memset(&msg, 0, sizeof(msg));
     msg.type = MSG_STATS;
-    send(sock, &msg, sizeof(msg), 0);
-    recv(sock, &msg, sizeof(msg), 0);
+    send_msg(sock, &msg);
+    if (recv_msg(sock, &msg) < 0) return -1;
 
     printf("\n=== СТАТИСТИКА ===\n");
     printf("Всего вошло: %d\n", msg.entered_count);
     printf("Мужчин: %d, Женщин: %d\n", msg.male_entered, msg.female_entered);
-    double avg_wait = (msg.entered_count > 0) ? (double)msg.total_wait_time / msg.entered_count : 0;
-    double avg_bath = (msg.entered_count > 0) ? (double)msg.total_bath_time / msg.entered_count : 0;
-    printf("Среднее ожидание: %.2f сек\n", avg_wait);
+    print_times("Ожидание (сервер)", msg.wait_ns, msg.wait_hist, &msg);
+    print_times("В ванной (сервер)", msg.bath_ns, msg.bath_hist, &msg);
+    if (msg.reclaimed_disconnect > 0 || msg.reclaimed_lease > 0) {
+        printf("Освобождено мест без LEAVE: обрыв соединения %d, истекла аренда %d\n",
+               msg.reclaimed_disconnect, msg.reclaimed_lease);
+    }
+    if (msg.grants > 0) {
+        printf("Захватов mutex сервера: %ld на %ld разрешений (%.3f на допуск)\n",
+               msg.lock_acquisitions, msg.grants, (double)msg.lock_acquisitions / msg.grants);
+    }
+    if (msg.grants > 0 && msg.syscalls > 0) {
+        printf("Системных вызовов циклов сервера: %ld (%.3f на допуск)\n",
+               msg.syscalls, (double)msg.syscalls / msg.grants);
+    }
+    if (rtt_count > 0) {
+        printf("Ожидание по часам клиента (с сетью): среднее %.3f мс\n",
+               rtt_sum_us / 1e3 / rtt_count);
+    }
 
     close(sock);
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "--open") == 0) {
+        double rate = atof(argv[2]), duration = atof(argv[3]);
+        double service_ms = argc > 4 ? atof(argv[4]) : 1;
+        int nconn = argc > 5 ? atoi(argv[5]) : OPEN_CONNS;
+        // Время в ванной не меньше 1 мкс: без него сервер не назначит
+        // выход, а клиент не пошлет LEAVE, и ванная заполнится навсегда
+        if (rate <= 0 || duration <= 0 || service_ms * 1000 < 1 || nconn <= 0 || rate * duration < 1) {
+            fprintf(stderr, "Некорректные параметры открытой нагрузки (мс_в_ванной - от 0.001)\n"
+                            "Использование: %s --open <студентов/с> <секунд> "
+                            "[мс_в_ванной [соединений_на_поток]]\n", argv[0]);
+            return -1;
+        }
+        read_config("config.txt");
+        int sock = run_open(rate, duration, service_ms, nconn);
+        if (sock < 0) return -1;
+        return print_server_stats(sock);
+    }
+
+    int mux = 0;
+    bool server_leave = false;
+    if ((argc == 4 || argc == 5) && strcmp(argv[2], "--mux") == 0) {
+        mux = atoi(argv[3]);
+        if (argc == 5) {
+            server_leave = strcmp(argv[4], "--server-leave") == 0;
+            if (!server_leave) mux = 0;
+        }
+    }
+    if (argc != 2 && mux <= 0) {
+        fprintf(stderr, "Использование: %s <число_студентов> [--mux соединений [--server-leave]]\n"
+                        "       %s --open <студентов/с> <секунд> [мс_в_ванной [соединений_на_поток]]\n",
+                argv[0], argv[0]);
+        return -1;
+    }
+
+    int total_students = atoi(argv[1]);
+    if (total_students <= 0) {
+        fprintf(stderr, "Некорректное число студентов: %s\n", argv[1]);
+        return -1;
+    }
+
+    read_config("config.txt");
+
+    int sock;
+    if (mux > 0) {
+        if (mux > total_students) mux = total_students;
+        sock = run_mux(total_students, mux, server_leave);
+    } else {
+        pthread_t threads[total_students];
+        for (int i = 0; i < total_students; i++) {
+            int *id = malloc(sizeof(int));
+            *id = i;
+            pthread_create(&threads[i], NULL, student_thread, id);
+            usleep(ARRIVAL_GAP_MS * 1000);
+        }
+
+        for (int i = 0; i < total_students; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        sock = connect_server();
+    }
+    if (sock < 0) return -1;
+
+    return print_server_stats(sock);
+}
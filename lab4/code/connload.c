@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// ============================================
+// НАГРУЗОЧНЫЙ ТЕСТ ПОДКЛЮЧЕНИЙ К server.c
+// ============================================
+// Открывает N соединений, ждет SERVER_READY на каждом, часть из них
+// запускает симуляцию, остальные держатся открытыми без активности.
+// Печатает скорость установки соединений и (с -p) память сервера на сессию.
+
+#define PORT 5050
+#define SERVER_IP "127.0.0.1"
+#define MAX_EVENTS 1024
+#define TAIL_SIZE 64
+
+typedef enum {
+    LC_CONNECTING,      // connect() в процессе
+    LC_WAIT_READY,      // ждем SERVER_READY
+    LC_IDLE,            // соединение установлено, простаивает
+    LC_SIMULATING,      // ждем "Симуляция завершена"
+    LC_DONE,            // симуляция завершена
+    LC_FAILED,
+} LoadState;
+
+typedef struct {
+    int fd;
+    LoadState state;
+    char tail[TAIL_SIZE];   // хвост принятых данных: маркер может разорваться
+    size_t tail_len;
+} LoadConn;
+
+double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Резидентная память процесса в КиБ
+ * @param pid - процесс сервера
+ */
+long rss_kib(int pid) {
+    char path[64];
+    long pages = 0, resident = 0;
+    snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+    FILE* f = fopen(path, "r");
+    if (f != NULL) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief Поиск маркера в новых данных с учетом хвоста предыдущих
+ * @param c - соединение
+ * @param data - принятые данные
+ * @param len - длина
+ * @param marker - искомая строка
+ */
+bool feed(LoadConn* c, const char* data, size_t len, const char* marker) {
+    char buf[TAIL_SIZE + 4096];
+    size_t take = len > 4096 ? 4096 : len;
+    memcpy(buf, c->tail, c->tail_len);
+    memcpy(buf + c->tail_len, data + len - take, take);
+    size_t total = c->tail_len + take;
+    buf[total] = '\0';
+
+    bool found = memmem(buf, total, marker, strlen(marker)) != NULL;
+
+    c->tail_len = total < TAIL_SIZE ? total : TAIL_SIZE;
+    memcpy(c->tail, buf + total - c->tail_len, c->tail_len);
+    if (found) {
+        c->tail_len = 0;
+    }
+    return found;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+        "Использование: %s [-n соединений] [-a активных] [-s студентов] "
+        "[-t удержание_с] [-p pid_сервера] [IP]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int total = 1000, active = 0, students = 2, hold = 5, server_pid = 0;
+    const char* ip = SERVER_IP;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:a:s:t:p:")) != -1) {
+        switch (opt) {
+        case 'n': total = atoi(optarg); break;
+        case 'a': active = atoi(optarg); break;
+        case 's': students = atoi(optarg); break;
+        case 't': hold = atoi(optarg); break;
+        case 'p': server_pid = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind < argc) {
+        ip = argv[optind];
+    }
+    if (total <= 0 || active < 0 || active > total) {
+        usage(argv[0]);
+    }
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Неверный IP-адрес: %s\n", ip);
+        return 1;
+    }
+
+    LoadConn* conns = calloc(total, sizeof(LoadConn));
+    int ep = epoll_create1(0);
+    long rss_before = server_pid ? rss_kib(server_pid) : 0;
+
+    // ============================================
+    // ЭТАП 1: установка соединений
+    // ============================================
+    double t0 = now_sec();
+    int pending = 0, ready = 0, failed = 0;
+    for (int i = 0; i < total; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            perror("socket");
+            conns[i].state = LC_FAILED;
+            failed++;
+            continue;
+        }
+        conns[i].fd = fd;
+        conns[i].state = LC_CONNECTING;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            close(fd);
+            conns[i].state = LC_FAILED;
+            failed++;
+            continue;
+        }
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+        pending++;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    char buf[4096];
+    int simulating = 0, busy = 0;
+    unsigned long sim_lines = 0, sim_bytes = 0;
+    double t_ready = 0, t_sim_start = 0;
+    long rss_after = 0;
+
+    while (pending > 0 || simulating > 0) {
+        int n = epoll_wait(ep, events, MAX_EVENTS, 10000);
+        if (n == 0) {
+            fprintf(stderr, "Таймаут: ожидают %d, симулируют %d\n", pending, simulating);
+            break;
+        }
+
+        for (int k = 0; k < n; k++) {
+            LoadConn* c = &conns[events[k].data.u32];
+            ssize_t len;
+            while ((len = recv(c->fd, buf, sizeof(buf), 0)) > 0) {
+                if (c->state == LC_CONNECTING || c->state == LC_WAIT_READY) {
+                    if (feed(c, buf, len, "SERVER_READY")) {
+                        c->state = LC_IDLE;
+                        pending--;
+                        ready++;
+                    } else {
+                        c->state = LC_WAIT_READY;
+                    }
+                } else if (c->state == LC_SIMULATING) {
+                    sim_bytes += len;
+                    for (ssize_t i = 0; i < len; i++) {
+                        sim_lines += (buf[i] == '\n');
+                    }
+                    // отказ контроля допуска: очередь заданий сервера заполнена
+                    if (memmem(buf, len, "BUSY", 4) != NULL) {
+                        c->state = LC_DONE;
+                        simulating--;
+                        busy++;
+                    } else if (feed(c, buf, len, "Симуляция завершена")) {
+                        c->state = LC_DONE;
+                        simulating--;
+                    }
+                }
+            }
+            if (len == 0 || (len < 0 && errno != EAGAIN)) {
+                if (c->state == LC_CONNECTING || c->state == LC_WAIT_READY) pending--;
+                if (c->state == LC_SIMULATING) simulating--;
+                c->state = LC_FAILED;
+                failed++;
+                epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+            }
+        }
+
+        // ============================================
+        // ЭТАП 2: все готовы - запуск активных симуляций
+        // ============================================
+        if (pending == 0 && t_ready == 0) {
+            t_ready = now_sec();
+            t_sim_start = t_ready;
+            // память меряем до симуляций: стеки потоков студентов
+            // не относятся к стоимости сессии
+            rss_after = server_pid ? rss_kib(server_pid) : 0;
+            char cmd[32];
+            int len = snprintf(cmd, sizeof(cmd), "%d\n", students);
+            for (int i = 0, started = 0; i < total && started < active; i++) {
+                if (conns[i].state == LC_IDLE) {
+                    send(conns[i].fd, cmd, len, MSG_NOSIGNAL);
+                    conns[i].state = LC_SIMULATING;
+                    simulating++;
+                    started++;
+                }
+            }
+        }
+    }
+    if (t_ready == 0) {
+        t_ready = now_sec();
+    }
+    double t_done = now_sec();
+
+    printf("\n=== НАГРУЗОЧНЫЙ ТЕСТ ПОДКЛЮЧЕНИЙ ===\n");
+    printf("Соединений: %d, готово: %d, ошибок: %d\n", total, ready, failed);
+    printf("Установка: %.3f с, %.0f соединений/с\n",
+           t_ready - t0, ready / (t_ready - t0));
+    if (active > 0) {
+        printf("Активных симуляций: %d по %d студентов, %.3f с, отклонено (BUSY): %d\n",
+               active, students, t_done - t_sim_start, busy);
+        double sim_sec = t_done - t_sim_start;
+        int served = active - busy;
+        if (served > 0 && sim_sec > 0) {
+            printf("Вывод: %lu строк, %lu байт; %.0f строк/с на соединение, %.0f строк/с всего\n",
+                   sim_lines, sim_bytes, sim_lines / sim_sec / served, sim_lines / sim_sec);
+        }
+    }
+    if (server_pid) {
+        printf("Память сервера: %ld -> %ld КиБ, %.0f байт на сессию\n",
+               rss_before, rss_after,
+               ready ? (rss_after - rss_before) * 1024.0 / ready : 0.0);
+    }
+
+    // ЭТАП 3: удержание простаивающих соединений
+    if (hold > 0) {
+        printf("Удержание %d соединений %d с...\n", ready, hold);
+        sleep(hold);
+    }
+
+    for (int i = 0; i < total; i++) {
+        if (conns[i].state != LC_FAILED) {
+            close(conns[i].fd);
+        }
+    }
+    free(conns);
+    close(ep);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// ЛОГАРИФМИЧЕСКИ-ЛИНЕЙНАЯ ГИСТОГРАММА (ЛР4)
+// ============================================
+// Значения (обычно микросекунды) делятся на октавы [2^k, 2^(k+1)),
+// каждая октава - на HIST_SUB равных корзин. Значения меньше HIST_SUB
+// хранятся точно, для остальных относительная погрешность квантиля
+// не больше 1/HIST_SUB. Запись - несколько сдвигов и инкремент,
+// поэтому гистограмму можно вести прямо в цикле измерений.
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_OCTAVES 40                             // до 2^44 единиц
+#define HIST_BUCKETS ((HIST_OCTAVES + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} Hist;
+
+static inline void hist_init(Hist* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+/**
+ * @brief Номер корзины для значения
+ * @param v - значение
+ */
+static inline unsigned hist_bucket(uint64_t v) {
+    if (v < HIST_SUB) {
+        return (unsigned)v;
+    }
+    unsigned shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    unsigned idx = (shift + 1) * HIST_SUB + (unsigned)((v >> shift) - HIST_SUB);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief Наибольшее значение, попадающее в корзину
+ * @param idx - номер корзины
+ */
+static inline uint64_t hist_bucket_high(unsigned idx) {
+    if (idx < HIST_SUB) {
+        return idx;
+    }
+    unsigned shift = idx / HIST_SUB - 1;
+    uint64_t sub = idx % HIST_SUB + HIST_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+static inline void hist_record(Hist* h, uint64_t v) {
+    h->counts[hist_bucket(v)]++;
+    h->total++;
+    h->sum += (double)v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hist_merge(Hist* dst, const Hist* src) {
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/**
+ * @brief Квантиль (верхняя граница корзины, не больше максимума)
+ * @param h - гистограмма
+ * @param q - доля от 0 до 1
+ */
+static inline uint64_t hist_quantile(const Hist* h, double q) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * h->total + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_high(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline double hist_mean(const Hist* h) {
+    return h->total ? h->sum / h->total : 0.0;
+}
+
+/**
+ * @brief Печать квантилей и распределения по октавам
+ * @param f - поток вывода
+ * @param h - гистограмма
+ * @param title - заголовок
+ * @param scale - делитель для печати (1000 - мкс в мс)
+ * @param unit - единица после деления
+ */
+static inline void hist_print(FILE* f, const Hist* h, const char* title, double scale, const char* unit) {
+    fprintf(f, "%s: %llu значений\n", title, (unsigned long long)h->total);
+    if (h->total == 0) {
+        return;
+    }
+    fprintf(f, "  мин %.3f  сред %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  макс %.3f %s\n",
+            h->min / scale, hist_mean(h) / scale,
+            hist_quantile(h, 0.5) / scale, hist_quantile(h, 0.9) / scale,
+            hist_quantile(h, 0.99) / scale, hist_quantile(h, 0.999) / scale,
+            h->max / scale, unit);
+
+    // Столбцы по октавам: одна строка на удвоение значения
+    uint64_t peak = 0, oct[HIST_OCTAVES + 1] = {0};
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        oct[i / HIST_SUB] += h->counts[i];
+    }
+    for (unsigned k = 0; k <= HIST_OCTAVES; k++) {
+        if (oct[k] > peak) peak = oct[k];
+    }
+    for (unsigned k = 0; k <= HIST_OCTAVES; k++) {
+        if (oct[k] == 0) {
+            continue;
+        }
+        double lo = k == 0 ? 0 : (double)((uint64_t)HIST_SUB << (k - 1));
+        int bar = (int)(40 * oct[k] / peak);
+        fprintf(f, "  >= %10.3f %s %8llu |%.*s\n", lo / scale, unit,
+                (unsigned long long)oct[k], bar > 0 ? bar : 1,
+                "########################################");
+    }
+}
+
+#endif
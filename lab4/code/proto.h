@@ -0,0 +1,188 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================
+// ДВОИЧНЫЙ ПРОТОКОЛ С КАДРАМИ (ЛР4)
+// ============================================
+// Соединение начинается в текстовом режиме: сервер шлет строку
+// SERVER_READY. Клиент, поддерживающий кадры, отвечает строкой
+// "proto bin <версия>"; сервер подтверждает кадром FR_HELLO и дальше
+// обе стороны обмениваются только кадрами. Клиент без этой строки
+// работает в прежнем текстовом режиме.
+//
+// Кадр: заголовок PROTO_HDR_SIZE байт + полезная нагрузка.
+//   [0..3] длина нагрузки, big-endian
+//   [4]    тип кадра (FrameType)
+//   [5]    версия протокола
+//   [6..7] зарезервировано (0)
+// Все целые поля нагрузок передаются в big-endian.
+
+#define PROTO_VERSION 1
+#define PROTO_HDR_SIZE 8
+#define PROTO_MAX_PAYLOAD (1024 * 1024)
+#define PROTO_HELLO_CMD "proto bin"
+
+typedef enum {
+    FR_HELLO = 1,   // сервер: режим кадров включен (u8 версия)
+    FR_READY,       // сервер готов принять команду
+    FR_CMD,         // клиент: текст команды (N, dorm N, submit N, ...)
+    FR_TEXT,        // произвольный текст (ответы, сохраненный результат)
+    FR_ERROR,       // текст ошибки
+    FR_BUSY,        // очередь заполнена: u32 секунд до повтора
+    FR_START,       // начало симуляции: ProtoStats
+    FR_EVENT,       // событие ванной: ProtoEvent
+    FR_STATS,       // итог симуляции: ProtoStats
+    FR_DONE,        // симуляция завершена
+    FR_DROPPED,     // пропущено рассылок: u32
+    FR_BYE,         // сервер закрывает соединение
+} FrameType;
+
+typedef enum {
+    PE_ENTER = 1,   // студент вошел
+    PE_LEAVE,       // студент вышел
+    PE_SWITCH,      // смена пола выполнена
+    PE_STREAK,      // достигнута максимальная серия
+} ProtoEventKind;
+
+#define PROTO_SEX_MAN 1
+#define PROTO_SEX_WOMAN 2
+
+// Событие ванной (PROTO_EVENT_SIZE байт в кадре FR_EVENT)
+typedef struct {
+    uint8_t kind;
+    uint8_t sex;
+    uint16_t student_id;
+    uint32_t shower_ms;
+    uint16_t cabins_used;
+    uint16_t cabins_total;
+    uint16_t streak;
+    uint16_t max_streak;
+    uint16_t waiting_men;
+    uint16_t waiting_women;
+} ProtoEvent;
+
+#define PROTO_EVENT_SIZE 20
+
+// Параметры и итог симуляции (PROTO_STATS_SIZE байт в FR_START/FR_STATS)
+typedef struct {
+    uint16_t students;
+    uint16_t cabins_total;
+    uint16_t max_streak;
+    uint8_t shared;             // общее общежитие
+    uint8_t reserved;
+    uint32_t avg_wait_us;       // только FR_STATS
+    uint32_t utilization_bp;    // утилизация, сотые доли процента
+    uint32_t total_ms;
+} ProtoStats;
+
+#define PROTO_STATS_SIZE 20
+
+static inline void proto_put16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline void proto_put32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint16_t proto_get16(const uint8_t* p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t proto_get32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/**
+ * @brief Заполнение заголовка кадра
+ * @param hdr - буфер PROTO_HDR_SIZE байт
+ * @param type - тип кадра
+ * @param len - длина нагрузки
+ */
+static inline void proto_header(uint8_t* hdr, uint8_t type, uint32_t len) {
+    proto_put32(hdr, len);
+    hdr[4] = type;
+    hdr[5] = PROTO_VERSION;
+    hdr[6] = 0;
+    hdr[7] = 0;
+}
+
+/**
+ * @brief Разбор заголовка кадра из накопленных данных
+ * @param buf - принятые данные
+ * @param avail - сколько байт принято
+ * @param type - тип кадра
+ * @param len - длина нагрузки (0, пока не принят весь заголовок)
+ * @return 1 - кадр целиком в буфере, 0 - нужно больше данных,
+ *         -1 - неверная версия или длина (соединение надо закрыть)
+ */
+static inline int proto_parse(const uint8_t* buf, size_t avail, uint8_t* type, uint32_t* len) {
+    if (avail < PROTO_HDR_SIZE) {
+        *len = 0;
+        *type = 0;
+        return 0;
+    }
+    *len = proto_get32(buf);
+    *type = buf[4];
+    if (buf[5] != PROTO_VERSION || *len > PROTO_MAX_PAYLOAD) {
+        return -1;
+    }
+    return avail >= PROTO_HDR_SIZE + *len ? 1 : 0;
+}
+
+static inline void proto_event_encode(uint8_t* p, const ProtoEvent* e) {
+    p[0] = e->kind;
+    p[1] = e->sex;
+    proto_put16(p + 2, e->student_id);
+    proto_put32(p + 4, e->shower_ms);
+    proto_put16(p + 8, e->cabins_used);
+    proto_put16(p + 10, e->cabins_total);
+    proto_put16(p + 12, e->streak);
+    proto_put16(p + 14, e->max_streak);
+    proto_put16(p + 16, e->waiting_men);
+    proto_put16(p + 18, e->waiting_women);
+}
+
+static inline void proto_event_decode(const uint8_t* p, ProtoEvent* e) {
+    e->kind = p[0];
+    e->sex = p[1];
+    e->student_id = proto_get16(p + 2);
+    e->shower_ms = proto_get32(p + 4);
+    e->cabins_used = proto_get16(p + 8);
+    e->cabins_total = proto_get16(p + 10);
+    e->streak = proto_get16(p + 12);
+    e->max_streak = proto_get16(p + 14);
+    e->waiting_men = proto_get16(p + 16);
+    e->waiting_women = proto_get16(p + 18);
+}
+
+static inline void proto_stats_encode(uint8_t* p, const ProtoStats* s) {
+    proto_put16(p, s->students);
+    proto_put16(p + 2, s->cabins_total);
+    proto_put16(p + 4, s->max_streak);
+    p[6] = s->shared;
+    p[7] = 0;
+    proto_put32(p + 8, s->avg_wait_us);
+    proto_put32(p + 12, s->utilization_bp);
+    proto_put32(p + 16, s->total_ms);
+}
+
+static inline void proto_stats_decode(const uint8_t* p, ProtoStats* s) {
+    s->students = proto_get16(p);
+    s->cabins_total = proto_get16(p + 2);
+    s->max_streak = proto_get16(p + 4);
+    s->shared = p[6];
+    s->reserved = 0;
+    s->avg_wait_us = proto_get32(p + 8);
+    s->utilization_bp = proto_get32(p + 12);
+    s->total_ms = proto_get32(p + 16);
+}
+
+#endif
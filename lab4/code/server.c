@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -7,18 +8,57 @@
 #include <linux/time.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "proto.h"
+#ifdef USE_IO_URING
+#include "uring.h"
+#endif
 
 // ============================================
 // НАСТРОЙКИ СЕТЕВОГО ПОДКЛЮЧЕНИЯ
 // ============================================
 #define PORT 5050           // Порт сервера (как требуется в задании)
-#define MAX_CLIENTS 2       // Максимальное количество клиентов (по заданию не более 2)
+#define UNIX_PATH "/tmp/lab4_server.sock"   // Локальный сокет (-U, "" - без него)
+#define MAX_CLIENTS 16384   // Максимальное количество клиентов по умолчанию (ключ -c)
 #define BUFFER_SIZE 1024    // Размер буфера для обмена данными
+#define CMD_BUFFER_SIZE 256 // Входной буфер клиента (команда с параметрами)
+#define MAX_EVENTS 256      // Событий epoll за одну итерацию реактора
+#define URING_ENTRIES 1024  // Очередь отправки кольца io_uring (сборка с USE_IO_URING)
+#define URING_BUFS 1024     // Буферов recv в кольце буферов
+#define URING_BUF_SIZE 2048 // Размер буфера recv
+#define SLAB_CLIENTS 1024   // Клиентов в одном блоке таблицы сессий
+#define BATH_POOL_KEEP 64   // Свободных ванных, удерживаемых пулом
+#define SIM_WORKERS 8       // Рабочих потоков симуляции по умолчанию (ключ -w)
+#define JOB_QUEUE_DEPTH 64  // Глубина очереди заданий по умолчанию (ключ -Q)
+#define JOB_HISTORY 4096    // Заданий, доступных по номеру (status/result)
+#define JOB_RESULT_MAX (256 * 1024) // Предел сохраненного вывода задания
+#define OUT_BLOCK_SIZE 4096 // Блок выходного буфера сессии
+#define OUT_FLUSH_BYTES 16384 // Порог размера: будить реактор сразу
+#define OUT_FLUSH_MS 5      // Порог времени: накопленный вывод уходит не позже
+#define OUT_IOV_MAX 64      // Блоков в одном вызове writev
+#define OUT_BCAST_LIMIT (64 * 1024)   // Выше этого отставания рассылки клиенту отбрасываются
+#define OUT_QUEUE_LIMIT (1024 * 1024) // Выше этого отставания клиент отключается
+#define BCAST_RING 256      // Очередь рассылок, ожидающих реактора
+#define SIM_MAX_STUDENTS 10000 // Предел студентов в запросе по умолчанию (ключ -S)
+#define SIM_MAX_CABINS 1024 // Предел кабинок и серии в запросе
+#define STUDENT_STACK (64 * 1024) // Стек потока студента
+#define SIM_MODEL_VERSION 1 // Версия модели: входит в ключ кэша, менять вместе с логикой симуляции
+#define CACHE_BUDGET_MB 64  // Память кэша результатов по умолчанию (ключ -M, 0 - без кэша)
+#define CACHE_BUCKETS 4096  // Корзин хеш-таблицы кэша
+#define CACHE_EVENTS_MAX 4096 // Результат с большим числом событий не кэшируется
+#define CACHE_FILE_MAGIC "BTRC" // Запись файла кэша (ключ -P)
 
 // ============================================
 // ЦВЕТОВЫЕ КОДЫ ДЛЯ КОНСОЛИ
@@ -60,19 +100,179 @@ struct Bathroom
     unsigned streak;                // Текущая серия одного пола
     unsigned max_streak;            // Максимальная серия
     bool force_change;              // Флаг принудительной смены пола
+
+    bool shared;                    // Общее общежитие: события видят все клиенты
+    struct Bathroom* next_free;     // Следующая свободная ванная в пуле
 };
 typedef struct Bathroom Br;
 
+// Блок выходного буфера: потоки симуляции дописывают в хвост цепочки,
+// реактор забирает всю цепочку разом и отправляет одним writev
+struct OutBlock
+{
+    struct OutBlock* next;
+    size_t len;                     // Заполнено байт
+    size_t off;                     // Уже отправлено байт
+    char data[OUT_BLOCK_SIZE];
+};
+typedef struct OutBlock OutBlock;
+
+// ============================================
+// СОСТОЯНИЕ ПОДКЛЮЧЕНИЯ
+// ============================================
+
+// Протокол: READY -> количество студентов -> симуляция -> результат -> READY
+typedef enum {
+    CONN_AWAIT_COUNT,   // отправлен SERVER_READY, ждем количество студентов
+    CONN_SIMULATING,    // идет симуляция, ввод копится во входном буфере
+    CONN_CLOSING,       // дописываем вывод и закрываем соединение
+} ConnState;
+
+// Подключение клиента. Весь ввод-вывод сокета выполняет реактор,
+// потоки симуляции только дописывают данные в выходной буфер
+struct Client
+{
+    int fd;
+    int slot;                       // Индекс в таблице клиентов
+    int next_free;                  // Следующий свободный слот
+    bool listed;                    // Виден рассылкам (под clients_mutex)
+    ConnState state;
+    bool binary;                    // Сессия перешла на кадры (proto bin)
+    bool dead;                      // Соединение закрыто реактором
+    int refs;                       // Реактор + задание симуляции (меняет только реактор)
+
+    char in[CMD_BUFFER_SIZE];       // Входной буфер (только реактор)
+    size_t in_len;
+
+    pthread_mutex_t out_mutex;      // Защита выходного буфера и флагов ниже
+    OutBlock* out_head;             // Накопленный вывод, ожидающий реактора
+    OutBlock* out_tail;
+    size_t out_bytes;
+    bool queued;                    // Клиент стоит в очереди уведомлений реактора
+    bool kicked;                    // Реактор уже разбужен по порогу размера
+    size_t backlog;                 // Не отправлено байт всего (буфер + цепочка реактора)
+    bool overflow;                  // Отставание превысило OUT_QUEUE_LIMIT: отключить
+    unsigned bcast_dropped;         // Пропущено рассылок с последнего уведомления
+    bool sim_done;                  // Симуляция завершена
+    struct Client* next_pending;
+
+    OutBlock* send_head;            // Забранный реактором вывод (только реактор)
+    OutBlock* send_tail;
+#ifdef USE_IO_URING
+    int sends;                      // SEND в кольце: блоки send_head по порядку
+    bool send_failed;               // SEND завершился ошибкой или недосылкой
+    bool recv_armed;                // Взведен multishot recv
+#endif
+};
+typedef struct Client Client;
+
+// ============================================
+// ЗАДАНИЯ СИМУЛЯЦИИ
+// ============================================
+
+typedef enum {
+    JOB_QUEUED,         // ждет свободного рабочего потока
+    JOB_RUNNING,        // выполняется
+    JOB_DONE,           // завершено
+    JOB_CANCELLED,      // клиент отключился до запуска
+} JobState;
+
+// Время в душе
+typedef enum {
+    DIST_LAB,           // как в ЛР1: 2-5 с, у женщин вдвое дольше
+    DIST_FIXED,         // fixed:T
+    DIST_UNIFORM,       // uniform:A:B
+    DIST_EXP,           // exp:M - экспоненциальное со средним M
+} ServiceDist;
+
+// Приход студентов
+typedef enum {
+    ARRIVE_BATCH,       // все сразу
+    ARRIVE_POISSON,     // poisson:R - пуассоновский поток, R студентов в секунду
+    ARRIVE_SPREAD,      // spread:T - равномерно в течение T секунд
+} ArrivalModel;
+
+// Параметры одной симуляции: "N cabins=K streak=S seed=X dist=... arrive=...
+// verbose=V scale=F". Все времена задаются в секундах модели и
+// умножаются на scale перед ожиданием
+typedef struct {
+    int students;
+    unsigned cabins;
+    unsigned max_streak;
+    unsigned seed;
+    bool seed_set;                  // Иначе seed выбирается при постановке в очередь
+    ServiceDist dist;
+    double dist_a, dist_b;
+    ArrivalModel arrive;
+    double arrive_p;
+    int verbose;                    // 0 - только итог, 1 - + смены и серии, 2 - все события
+    double scale;
+    bool shared;                    // В общем общежитии (dorm)
+} SimParams;
+
+// Задание: выполняется рабочим потоком из пула. Вывод либо идет в сессию
+// клиента (обычная команда N), либо сохраняется в задании (submit N)
+// и забирается позже командой result
+struct Job
+{
+    unsigned long id;
+    SimParams params;
+    Client* client;                 // Сессия для потокового вывода или NULL
+    JobState state;                 // Под jobs_mutex
+
+    pthread_mutex_t out_mutex;      // Защита сохраненного вывода
+    char* result;
+    size_t result_len;
+    size_t result_cap;
+
+    // Запись результата для кэша: события пишутся под dataMutex
+    // собственной ванной задания, итог - рабочим потоком
+    bool cacheable;
+    bool rec_overflow;              // Событий больше CACHE_EVENTS_MAX
+    ProtoStats rec_start;
+    ProtoStats rec_stats;
+    ProtoEvent* rec;
+    size_t rec_len;
+    size_t rec_cap;
+
+    struct Job* next;               // Следующее задание в очереди
+};
+typedef struct Job Job;
+
+// ============================================
+// КЭШ РЕЗУЛЬТАТОВ
+// ============================================
+
+// Запись кэша: итог и события одной симуляции с заданным seed.
+// Хранится в нейтральном виде (ProtoStats/ProtoEvent), поэтому
+// отдается и текстовым, и двоичным клиентам
+struct CacheEntry
+{
+    char* key;                      // "m<версия модели> <канонические параметры>"
+    uint32_t hash;
+    ProtoStats start;
+    ProtoStats stats;
+    ProtoEvent* events;
+    size_t nevents;
+    size_t bytes;                   // Объем, учитываемый в бюджете
+    struct CacheEntry* hnext;       // Цепочка корзины
+    struct CacheEntry* prev;        // Список LRU: в голове самые свежие
+    struct CacheEntry* next;
+};
+typedef struct CacheEntry CacheEntry;
+
 // Структура студента (потока)
 struct Student
 {
     int studentID;
     enum State sex;
     float timeForShower;
+    struct timespec arrive_at;      // Плановый момент прихода
     struct timespec arrival;
     struct timespec enter;
     struct timespec leave;
-    int client_socket;
+    Job* job;                       // Задание, которому принадлежит студент
+    struct Bathroom* bath;          // Ванная симуляции студента
 };
 typedef struct Student St;
 
@@ -82,8 +282,9 @@ const int BATHROOM_CAPACITY = 4;
 // ГЛОБАЛЬНЫЕ ПЕРЕМЕННЫЕ
 // ============================================
 
-// Глобальная ванная (разделяемый ресурс между потоками)
-struct Bathroom b = {
+// Общее общежитие: одна ванная на все симуляции, запущенные
+// командой "dorm N" (или всеми симуляциями при ключе -s)
+struct Bathroom dorm = {
     .dataMutex = PTHREAD_MUTEX_INITIALIZER,
     .condMutex = PTHREAD_MUTEX_INITIALIZER,
     .cond = PTHREAD_COND_INITIALIZER,
@@ -96,13 +297,102 @@ struct Bathroom b = {
     .waiting_women = 0,
     .streak = 0,
     .max_streak = MAX_STREAK_FOR_STATE,
+    .shared = true,
 };
-
-// Массив клиентских сокетов для отслеживания подключений
-int client_sockets[MAX_CLIENTS];
+bool dorm_default = false;      // Все симуляции в общем общежитии (-s)
+
+// Пул отдельных ванных: у каждой симуляции своя ванная со своими
+// кабинками, счетчиками и мьютексом, поэтому параллельные симуляции
+// не влияют друг на друга и не конкурируют за одну блокировку
+Br* bath_free_head = NULL;
+int bath_free_count = 0;
+pthread_mutex_t bath_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Таблица сессий: блоки по SLAB_CLIENTS структур (адреса не меняются)
+// и список свободных слотов. Рассылки из потоков симуляции обходят ее
+// под clients_mutex
+Client** client_slabs = NULL;
+int client_slab_count = 0;
+int client_high = 0;            // Слотов когда-либо выдано
+int client_free_head = -1;      // Голова списка свободных слотов
+int max_clients = MAX_CLIENTS;
 int num_clients = 0;
+bool quiet = false;             // Не печатать каждое подключение (-q)
+bool bench_mode = false;        // Нулевое время в душе: замер пропускной способности (-B)
+int sim_max_students = SIM_MAX_STUDENTS;
 pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Очередь заданий и пул рабочих потоков: число потоков фиксировано,
+// поэтому общее число потоков ограничено workers * (1 + sim_max_students)
+Job* job_head = NULL;
+Job* job_tail = NULL;
+Job* job_table[JOB_HISTORY];    // Задание по номеру: id % JOB_HISTORY
+unsigned long job_next_id = 1;
+int job_depth = 0;              // Заданий в очереди
+int job_running = 0;            // Заданий выполняется
+int job_workers = SIM_WORKERS;
+int job_queue_limit = JOB_QUEUE_DEPTH;
+unsigned long job_completed = 0;
+unsigned long job_rejected = 0;
+double job_avg_sec = 0.0;       // Скользящее среднее длительности задания
+pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+// Кэш результатов: под cache_mutex, который не вкладывается в другие
+// блокировки (попадание копируется и воспроизводится без него)
+CacheEntry* cache_table[CACHE_BUCKETS];
+CacheEntry* cache_lru_head = NULL;
+CacheEntry* cache_lru_tail = NULL;
+size_t cache_budget = (size_t)CACHE_BUDGET_MB * 1024 * 1024;
+size_t cache_bytes = 0;
+unsigned long cache_entries = 0;
+unsigned long cache_hits = 0;
+unsigned long cache_misses = 0;
+unsigned long cache_evicted = 0;
+FILE* cache_file = NULL;        // Журнал записей кэша (-P)
+pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Очередь уведомлений реактору от потоков симуляции:
+// есть данные на отправку или симуляция завершена
+Client* pending_head = NULL;
+pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+int wake_fd = -1;           // eventfd для пробуждения реактора
+int epoll_fd = -1;
+bool use_select = false;    // Реактор на select (-L): база для сравнения с epoll
+
+// Выход копится в буфере сессии и отправляется пачкой: реактор будят
+// только по первому событию (запуск таймера OUT_FLUSH_MS), по порогу
+// размера OUT_FLUSH_BYTES и по завершению симуляции. С -u каждое событие
+// будит реактор и отправляется сразу (для сравнения)
+bool unbuffered = false;
+bool flush_now = false;     // Отправить без ожидания таймера (атомарно)
+unsigned long out_events = 0;   // Сообщений поставлено в буферы (атомарно)
+unsigned long out_calls = 0;    // Вызовов sendmsg (только реактор)
+unsigned long out_sent = 0;     // Отправлено байт (только реактор)
+unsigned long reactor_syscalls = 0; // Системных вызовов реактора (только реактор)
+unsigned long reactor_cmds = 0;     // Команд клиентов (только реактор)
+
+// Рассылки общего общежития: ванная только кладет сообщение в кольцо,
+// а по буферам клиентов его раскладывает реактор. Отстающему клиенту
+// рассылки не ставятся (вместо них одно уведомление о пропуске),
+// клиент с отставанием больше OUT_QUEUE_LIMIT отключается
+ProtoEvent bcast_ring[BCAST_RING];
+unsigned bcast_head = 0, bcast_tail = 0;
+pthread_mutex_t bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned long bcast_lost = 0;       // Кольцо заполнено: рассылка потеряна (под bcast_mutex)
+unsigned long bcast_dropped = 0;    // Рассылок не доставлено отстающим клиентам (реактор)
+unsigned long slow_closed = 0;      // Отключено медленных клиентов (реактор)
+
+// Метки для различения служебных дескрипторов в epoll
+static char listen_tag, unix_tag, wake_tag;
+
+#ifdef USE_IO_URING
+bool use_uring = false;     // Реактор на io_uring; иначе - запасной путь epoll
+void uring_client_close(Client* c);
+void uring_client_send(Client* c);
+void uring_recv_arm(Client* c);
+#endif
+
 // ============================================
 // ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
 // ============================================
@@ -112,46 +402,577 @@ double timespec_diff(Time a, Time b) {
     return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
 }
 
+// Монотонное время в миллисекундах (таймер отправки вывода)
+long now_ms(void) {
+    Time t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
 // ============================================
 // СЕТЕВЫЕ ФУНКЦИИ ОТПРАВКИ ДАННЫХ
 // ============================================
 
+/**
+ * @brief Добавление данных в выходной буфер клиента
+ * @param c - клиент
+ * @param data - данные
+ * @param len - длина данных
+ *
+ * Вызывается под c->out_mutex. Данные закрытого клиента отбрасываются.
+ * Только копирование в блоки, без системных вызовов.
+ */
+void out_append(Client* c, const char* data, size_t len) {
+    if (c->dead) {
+        return;
+    }
+    while (len > 0) {
+        OutBlock* blk = c->out_tail;
+        if (blk == NULL || blk->len == OUT_BLOCK_SIZE) {
+            blk = malloc(sizeof(OutBlock));
+            blk->next = NULL;
+            blk->len = blk->off = 0;
+            if (c->out_tail != NULL) {
+                c->out_tail->next = blk;
+            } else {
+                c->out_head = blk;
+            }
+            c->out_tail = blk;
+        }
+        size_t n = OUT_BLOCK_SIZE - blk->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(blk->data + blk->len, data, n);
+        blk->len += n;
+        c->out_bytes += n;
+        c->backlog += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Добавление сообщения с учетом режима сессии
+ * @param c - клиент
+ * @param type - тип кадра (FrameType)
+ * @param data - нагрузка
+ * @param len - длина нагрузки
+ *
+ * Вызывается под c->out_mutex. В двоичном режиме перед данными пишется
+ * заголовок кадра, в текстовом данные идут как есть.
+ */
+void out_append_msg(Client* c, uint8_t type, const void* data, size_t len) {
+    if (c->binary) {
+        uint8_t hdr[PROTO_HDR_SIZE];
+        proto_header(hdr, type, len);
+        out_append(c, (const char*)hdr, sizeof(hdr));
+    }
+    out_append(c, data, len);
+}
+
+/**
+ * @brief Освобождение цепочки блоков вывода
+ * @param blk - первый блок
+ */
+void out_free_chain(OutBlock* blk) {
+    while (blk != NULL) {
+        OutBlock* next = blk->next;
+        free(blk);
+        blk = next;
+    }
+}
+
+/**
+ * @brief Пробуждение реактора через eventfd
+ * @param urgent - отправить накопленное сразу, не дожидаясь таймера
+ *
+ * Вызывается вне блокировки ванной: это единственный системный вызов
+ * на пути события от студента к сокету.
+ */
+void reactor_wake(bool urgent) {
+    if (urgent) {
+        __atomic_store_n(&flush_now, true, __ATOMIC_RELEASE);
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("eventfd write");
+    }
+}
+
+/**
+ * @brief Постановка клиента в очередь уведомлений реактора
+ * @param c - клиент (c->queued уже выставлен вызывающим)
+ * @return true, если очередь была пуста (реактор надо разбудить)
+ */
+bool pending_push(Client* c) {
+    pthread_mutex_lock(&pending_mutex);
+    bool was_empty = (pending_head == NULL);
+    c->next_pending = pending_head;
+    pending_head = c;
+    pthread_mutex_unlock(&pending_mutex);
+    return was_empty;
+}
+
+/**
+ * @brief Постановка сообщения в буфер клиента без пробуждения реактора
+ * @param c - клиент (вызывается под c->out_mutex)
+ * @param type - тип кадра для двоичного режима
+ * @param data - нагрузка
+ * @param len - длина нагрузки
+ * @param urgent - сюда добавляется признак срочной отправки
+ * @return true, если реактор нужно разбудить (вызывающий делает это
+ *         после снятия своих блокировок через reactor_wake)
+ */
+bool out_enqueue_locked(Client* c, uint8_t type, const void* data, size_t len, bool* urgent) {
+    bool wake = false;
+    if (!c->dead && !c->overflow && c->backlog + len > OUT_QUEUE_LIMIT) {
+        // Клиент не читает: вывод больше не копим, реактор его отключит
+        c->overflow = true;
+        if (!c->queued) {
+            c->queued = true;
+            pending_push(c);
+        }
+        *urgent = true;
+        wake = true;
+    }
+    if (!c->dead && !c->overflow) {
+        out_append_msg(c, type, data, len);
+        __atomic_add_fetch(&out_events, 1, __ATOMIC_RELAXED);
+        if (!c->queued) {
+            c->queued = true;
+            wake = pending_push(c);
+        }
+        if (unbuffered || (c->out_bytes >= OUT_FLUSH_BYTES && !c->kicked)) {
+            c->kicked = true;
+            *urgent = true;
+            wake = true;
+        }
+    }
+    return wake;
+}
+
+/**
+ * @brief Постановка текстового сообщения в буфер клиента (FR_TEXT)
+ * @param c - клиент
+ * @param msg - сообщение
+ * @param urgent - признак срочной отправки
+ * @return true, если реактор нужно разбудить после снятия блокировок
+ */
+bool out_enqueue(Client* c, const char* msg, bool* urgent) {
+    if (c == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&c->out_mutex);
+    bool wake = out_enqueue_locked(c, FR_TEXT, msg, strlen(msg), urgent);
+    pthread_mutex_unlock(&c->out_mutex);
+    return wake;
+}
+
+/**
+ * @brief Текстовое представление события ванной (как в ЛР1)
+ * @param e - событие
+ * @param buf - буфер
+ * @param size - размер буфера
+ */
+void format_event(const ProtoEvent* e, char* buf, size_t size) {
+    bool is_man = (e->sex == PROTO_SEX_MAN);
+    switch (e->kind) {
+    case PE_ENTER:
+        snprintf(buf, size,
+            COLOR_GREEN"%4d. Студент (%-5s) in, время (%5.3f). Занято: %d/%d Серия: %d/%d \twait_m: %d wait_w: %d\n"COLOR_RESET,
+            e->student_id, is_man ? "man" : "woman", e->shower_ms / 1000.0,
+            e->cabins_used, e->cabins_total,
+            e->streak, e->max_streak,
+            e->waiting_men, e->waiting_women);
+        break;
+    case PE_LEAVE:
+        snprintf(buf, size,
+            COLOR_RED"%4d. Student (%-5s) out. Занято: %d/%d\n"COLOR_RESET,
+            e->student_id, is_man ? "man" : "woman",
+            e->cabins_used, e->cabins_total);
+        break;
+    case PE_SWITCH:
+        snprintf(buf, size,
+            COLOR_YELLOW"\t>>> СМЕНА ПОЛА ВЫПОЛНЕНА: Теперь в ванной %s <<<\n"COLOR_RESET,
+            is_man ? "мужчины" : "женщины");
+        break;
+    case PE_STREAK:
+        snprintf(buf, size,
+            COLOR_YELLOW"\t>>> СМЕНА: Достигнута максимальная серия (%d) для %6s! <<<\n"COLOR_RESET,
+            e->max_streak, is_man ? "мужчин" : "женщин");
+        break;
+    default:
+        buf[0] = '\0';
+    }
+}
+
+/**
+ * @brief Постановка события ванной в буфер клиента
+ * @param c - клиент (вызывается под c->out_mutex)
+ * @param e - событие
+ * @param urgent - признак срочной отправки
+ * @return true, если реактор нужно разбудить после снятия блокировок
+ *
+ * Двоичной сессии уходит кадр FR_EVENT, текстовой - строка.
+ */
+bool out_enqueue_event_locked(Client* c, const ProtoEvent* e, bool* urgent) {
+    if (c->binary) {
+        uint8_t p[PROTO_EVENT_SIZE];
+        proto_event_encode(p, e);
+        return out_enqueue_locked(c, FR_EVENT, p, sizeof(p), urgent);
+    }
+    char msg[256];
+    format_event(e, msg, sizeof(msg));
+    return out_enqueue_locked(c, FR_TEXT, msg, strlen(msg), urgent);
+}
+
 /**
  * @brief Отправка сообщения конкретному клиенту
- * @param sock - сокет клиента
+ * @param c - клиент
  * @param msg - сообщение для отправки
  * 
- * Использует системный вызов send() для передачи данных через TCP-сокет.
- * Флаг 0 означает стандартное поведение (блокирующая отправка).
+ * Вызывается из потоков симуляции: сообщение только дописывается
+ * в выходной буфер, а отправку пачкой выполняет реактор.
  */
-void send_to_client(int sock, const char* msg) {
-    if (sock > 0) {
-        // send(sockfd, buffer, length, flags)
-        // sock - дескриптор сокета
-        // msg - указатель на данные
-        // strlen(msg) - длина данных
-        // 0 - флаги (стандартное поведение)
-        send(sock, msg, strlen(msg), 0);
+void send_to_client(Client* c, const char* msg) {
+    bool urgent = false;
+    if (out_enqueue(c, msg, &urgent)) {
+        reactor_wake(urgent);
     }
 }
 
+void job_store(Job* j, const char* msg);
+
 /**
- * @brief Рассылка сообщения всем подключенным клиентам
- * @param msg - сообщение для рассылки
- * 
- * Использует мьютекс для защиты доступа к массиву клиентских сокетов.
- * Проходит по всем слотам и отправляет сообщение активным клиентам.
+ * @brief Вывод задания симуляции без пробуждения реактора
+ * @param j - задание
+ * @param msg - сообщение
+ * @param urgent - признак срочной отправки (см. out_enqueue)
+ * @return true, если реактор нужно разбудить после снятия блокировок
+ *
+ * Потоковое задание пишет в сессию клиента, отложенное (submit) -
+ * в собственный буфер результата.
+ */
+bool job_emit_deferred(Job* j, const char* msg, bool* urgent) {
+    if (j->client != NULL) {
+        return out_enqueue(j->client, msg, urgent);
+    }
+
+    job_store(j, msg);
+    return false;
+}
+
+/**
+ * @brief Сохранение текста в результате отложенного задания
+ * @param j - задание
+ * @param msg - текст
+ */
+void job_store(Job* j, const char* msg) {
+    size_t len = strlen(msg);
+    pthread_mutex_lock(&j->out_mutex);
+    if (j->result_len + len <= JOB_RESULT_MAX) {
+        if (j->result_len + len > j->result_cap) {
+            size_t cap = j->result_cap ? j->result_cap : 4096;
+            while (cap < j->result_len + len) {
+                cap *= 2;
+            }
+            j->result = realloc(j->result, cap);
+            j->result_cap = cap;
+        }
+        memcpy(j->result + j->result_len, msg, len);
+        j->result_len += len;
+    }
+    pthread_mutex_unlock(&j->out_mutex);
+}
+
+/**
+ * @brief Событие ванной в вывод задания без пробуждения реактора
+ * @param j - задание
+ * @param e - событие
+ * @param urgent - признак срочной отправки
+ * @return true, если реактор нужно разбудить после снятия блокировок
+ */
+bool job_emit_event_deferred(Job* j, const ProtoEvent* e, bool* urgent) {
+    if (j->cacheable && !j->rec_overflow) {
+        if (j->rec_len == CACHE_EVENTS_MAX) {
+            j->rec_overflow = true;
+        } else {
+            if (j->rec_len == j->rec_cap) {
+                j->rec_cap = j->rec_cap ? j->rec_cap * 2 : 64;
+                j->rec = realloc(j->rec, j->rec_cap * sizeof(ProtoEvent));
+            }
+            j->rec[j->rec_len++] = *e;
+        }
+    }
+
+    if (j->client != NULL) {
+        pthread_mutex_lock(&j->client->out_mutex);
+        bool wake = out_enqueue_event_locked(j->client, e, urgent);
+        pthread_mutex_unlock(&j->client->out_mutex);
+        return wake;
+    }
+
+    char msg[256];
+    format_event(e, msg, sizeof(msg));
+    job_store(j, msg);
+    return false;
+}
+
+/**
+ * @brief Начало или итог симуляции в вывод задания
+ * @param j - задание
+ * @param type - FR_START или FR_STATS
+ * @param s - параметры и итог
+ *
+ * Двоичной сессии уходит один кадр, текстовой - прежние строки.
+ */
+void job_emit_stats(Job* j, uint8_t type, const ProtoStats* s) {
+    Client* c = j->client;
+    char msg[512];
+
+    if (j->cacheable) {
+        if (type == FR_START) {
+            j->rec_start = *s;
+        } else {
+            j->rec_stats = *s;
+        }
+    }
+
+    if (type == FR_START) {
+        snprintf(msg, sizeof(msg),
+            COLOR_RESET"\tНачало: студентов - %d, кабинок - %d, максимальная серия - %d%s\n"COLOR_RESET,
+            s->students, s->cabins_total, s->max_streak, s->shared ? " (общее общежитие)" : "");
+    } else {
+        snprintf(msg, sizeof(msg),
+            COLOR_RESET"\t=======================Завершение======================\n"COLOR_RESET
+            COLOR_RESET"Среднее время ожидания: %f\n"COLOR_RESET
+            COLOR_RESET"Утилизация: %.2f%%\n"COLOR_RESET,
+            s->avg_wait_us / 1e6, s->utilization_bp / 100.0);
+    }
+
+    if (c == NULL) {
+        job_store(j, msg);
+        return;
+    }
+
+    bool urgent = false, wake;
+    pthread_mutex_lock(&c->out_mutex);
+    if (c->binary) {
+        uint8_t p[PROTO_STATS_SIZE];
+        proto_stats_encode(p, s);
+        wake = out_enqueue_locked(c, type, p, sizeof(p), &urgent);
+    } else {
+        wake = out_enqueue_locked(c, FR_TEXT, msg, strlen(msg), &urgent);
+    }
+    pthread_mutex_unlock(&c->out_mutex);
+    if (wake) {
+        reactor_wake(urgent);
+    }
+}
+
+/**
+ * @brief Вывод задания симуляции
+ * @param j - задание
+ * @param msg - сообщение
  */
-void broadcast_to_clients(const char* msg) {
+void job_emit(Job* j, const char* msg) {
+    bool urgent = false;
+    if (job_emit_deferred(j, msg, &urgent)) {
+        reactor_wake(urgent);
+    }
+}
+
+// ============================================
+// ТАБЛИЦА СЕССИЙ
+// ============================================
+
+/**
+ * @brief Клиент по индексу слота
+ * @param slot - индекс
+ */
+static inline Client* client_at(int slot) {
+    return &client_slabs[slot / SLAB_CLIENTS][slot % SLAB_CLIENTS];
+}
+
+/**
+ * @brief Выделение слота под новую сессию
+ * @return клиент или NULL, если достигнут лимит
+ *
+ * Сначала берется слот из списка свободных, иначе следующий по порядку;
+ * новые блоки выделяются по мере роста числа сессий.
+ */
+Client* client_alloc(void) {
     pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0) {
-            send(client_sockets[i], msg, strlen(msg), 0);
+
+    int slot = -1;
+    if (client_free_head >= 0) {
+        slot = client_free_head;
+        client_free_head = client_at(slot)->next_free;
+    } else if (client_high < max_clients) {
+        if (client_high == client_slab_count * SLAB_CLIENTS) {
+            client_slabs = realloc(client_slabs, (client_slab_count + 1) * sizeof(Client*));
+            client_slabs[client_slab_count++] = calloc(SLAB_CLIENTS, sizeof(Client));
         }
+        slot = client_high++;
+    }
+
+    Client* c = NULL;
+    if (slot >= 0) {
+        c = client_at(slot);
+        memset(c, 0, sizeof(*c));
+        c->slot = slot;
+        c->next_free = -1;
+        c->refs = 1;
+        pthread_mutex_init(&c->out_mutex, NULL);
     }
+
     pthread_mutex_unlock(&clients_mutex);
+    return c;
+}
+
+/**
+ * @brief Возврат слота в список свободных
+ * @param c - клиент
+ */
+void client_release(Client* c) {
+    pthread_mutex_destroy(&c->out_mutex);
+
+    pthread_mutex_lock(&clients_mutex);
+    c->next_free = client_free_head;
+    client_free_head = c->slot;
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+/**
+ * @brief Постановка рассылки в очередь реактора
+ * @param e - событие для рассылки
+ * @return true, если реактор нужно разбудить после снятия блокировок
+ *
+ * Вызывается под блокировкой ванной: только копирование в кольцо,
+ * без обхода таблицы клиентов и без системных вызовов. Если реактор
+ * не успевает разбирать кольцо, сообщение теряется и учитывается.
+ */
+bool broadcast_deferred(const ProtoEvent* e) {
+    pthread_mutex_lock(&bcast_mutex);
+    bool was_empty = (bcast_head == bcast_tail);
+    if (bcast_head - bcast_tail == BCAST_RING) {
+        bcast_lost++;
+    } else {
+        bcast_ring[bcast_head % BCAST_RING] = *e;
+        bcast_head++;
+    }
+    pthread_mutex_unlock(&bcast_mutex);
+    return was_empty;
+}
+
+// ============================================
+// ПУЛ ВАННЫХ
+// ============================================
+
+/**
+ * @brief Сброс состояния ванной к начальному
+ * @param br - ванная (мьютексы и условная переменная не трогаются)
+ */
+void bath_reset(Br* br) {
+    br->cabins_total = BATHROOM_CAPACITY;
+    br->cabins_used = 0;
+    br->state = nobody;
+    br->last_state = nobody;
+    br->force_change = false;
+    br->waiting_men = 0;
+    br->waiting_women = 0;
+    br->streak = 0;
+    br->max_streak = MAX_STREAK_FOR_STATE;
+    br->shared = false;
+    br->next_free = NULL;
+}
+
+/**
+ * @brief Получение отдельной ванной для симуляции
+ * @return ванная из пула или новая, NULL при нехватке памяти
+ */
+Br* bath_acquire(void) {
+    pthread_mutex_lock(&bath_pool_mutex);
+    Br* br = bath_free_head;
+    if (br != NULL) {
+        bath_free_head = br->next_free;
+        bath_free_count--;
+    }
+    pthread_mutex_unlock(&bath_pool_mutex);
+
+    if (br == NULL) {
+        br = (Br*)malloc(sizeof(Br));
+        if (br == NULL) {
+            return NULL;
+        }
+        pthread_mutex_init(&br->dataMutex, NULL);
+        pthread_mutex_init(&br->condMutex, NULL);
+        pthread_cond_init(&br->cond, NULL);
+    }
+    bath_reset(br);
+    return br;
+}
+
+/**
+ * @brief Возврат ванной в пул после завершения симуляции
+ * @param br - ванная (все потоки студентов уже завершены)
+ *
+ * Пул удерживает не больше BATH_POOL_KEEP ванных, лишние освобождаются.
+ */
+void bath_release(Br* br) {
+    pthread_mutex_lock(&bath_pool_mutex);
+    if (bath_free_count < BATH_POOL_KEEP) {
+        br->next_free = bath_free_head;
+        bath_free_head = br;
+        bath_free_count++;
+        br = NULL;
+    }
+    pthread_mutex_unlock(&bath_pool_mutex);
+
+    if (br != NULL) {
+        pthread_mutex_destroy(&br->dataMutex);
+        pthread_mutex_destroy(&br->condMutex);
+        pthread_cond_destroy(&br->cond);
+        free(br);
+    }
 }
 
+/**
+ * @brief Уведомление о смене состояния ванной
+ * @param b - ванная
+ * @param s - студент, вызвавший событие
+ * @param kind - вид события (ProtoEventKind)
+ * @param urgent - признак срочной отправки (см. out_enqueue)
+ * @return true, если реактор нужно разбудить после снятия блокировки ванной
+ *
+ * Вызывается под dataMutex: событие фиксирует состояние ванной на момент
+ * вызова. События смены общего общежития рассылаются всем клиентам,
+ * остальные получает только клиент этой симуляции.
+ */
+bool bath_notify(Br* b, St* s, uint8_t kind, bool* urgent) {
+    ProtoEvent e = {
+        .kind = kind,
+        .sex = s->sex == man ? PROTO_SEX_MAN : PROTO_SEX_WOMAN,
+        .student_id = s->studentID,
+        .shower_ms = (uint32_t)(s->timeForShower * 1000),
+        .cabins_used = b->cabins_used,
+        .cabins_total = b->cabins_total,
+        .streak = b->streak,
+        .max_streak = b->max_streak,
+        .waiting_men = b->waiting_men,
+        .waiting_women = b->waiting_women,
+    };
+
+    if (b->shared && (kind == PE_SWITCH || kind == PE_STREAK)) {
+        return broadcast_deferred(&e);
+    }
+    int need = (kind == PE_ENTER || kind == PE_LEAVE) ? 2 : 1;
+    if (s->job->params.verbose < need) {
+        return false;
+    }
+    return job_emit_event_deferred(s->job, &e, urgent);
+}
 
 // Проверка возможности входа в ванную
 bool canEnter(Br* b, St* s) {
@@ -195,8 +1016,10 @@ bool canEnter(Br* b, St* s) {
     return true;
 }
 
-// Вход в ванную
+// Вход в ванную. Сообщения под блокировкой только копируются в буфер
+// сессии; пробуждение реактора (системный вызов) - после ее снятия
 bool enterBathroom(Br *b, St *s) {
+    bool wake = false, urgent = false;
     // pthread_mutex_lock(&b->condMutex);
     pthread_mutex_lock(&b->dataMutex);
     // Увеличиваем счетчик ожидающих
@@ -216,11 +1039,7 @@ bool enterBathroom(Br *b, St *s) {
     if (b->state == nobody) {
         if (b->force_change && b->last_state != s->sex) {
             b->force_change = false;
-            char msg[256];
-            snprintf(msg, sizeof(msg), COLOR_YELLOW"\t>>> СМЕНА ПОЛА ВЫПОЛНЕНА: Теперь в ванной %s <<<\n"COLOR_RESET,
-                   s->sex == man ? "мужчины" : "женщины");
-            // printf("%s", msg);
-            broadcast_to_clients(msg);
+            wake |= bath_notify(b, s, PE_SWITCH, &urgent);
         }
         b->state = s->sex;
         b->streak = 0;
@@ -229,36 +1048,24 @@ bool enterBathroom(Br *b, St *s) {
     b->cabins_used++;
     b->streak++;
     
-    // Формируем сообщение о входе
-    char msg[512];
-    snprintf(msg, sizeof(msg), 
-        COLOR_GREEN"%4d. Студент (%-5s) in, время (%5.3f). Занято: %d/%d Серия: %d/%d \twait_m: %d wait_w: %d\n"COLOR_RESET,
-        s->studentID,
-        s->sex == man ? "man":"woman",
-        s->timeForShower,
-        b->cabins_used, b->cabins_total,
-        b->streak, b->max_streak,
-        b->waiting_men, b->waiting_women);
-    
-    // printf("%s", msg);
-    send_to_client(s->client_socket, msg);
+    // Событие о входе
+    wake |= bath_notify(b, s, PE_ENTER, &urgent);
 
     // Уведомление о достижении максимальной серии
     if (b->streak == b->max_streak) {
-        snprintf(msg, sizeof(msg), 
-            COLOR_YELLOW"\t>>> СМЕНА: Достигнута максимальная серия (%d) для %6s! <<<\n"COLOR_RESET,
-            b->max_streak,
-            s->sex == man ? "мужчин" : "женщин");
-        // printf("%s", msg);
-        broadcast_to_clients(msg);
+        wake |= bath_notify(b, s, PE_STREAK, &urgent);
     }
     
     pthread_mutex_unlock(&b->dataMutex);
+    if (wake) {
+        reactor_wake(urgent);
+    }
     return true;
 }
 
 // Выход из ванной
 void leaveBathroom(Br* b, St* s) {
+    bool wake = false, urgent = false;
     // pthread_mutex_lock(&b->condMutex);
     pthread_mutex_lock(&b->dataMutex);
 
@@ -276,222 +1083,2238 @@ void leaveBathroom(Br* b, St* s) {
         b->streak = 0;
     }
     
-    // Формируем сообщение о выходе
-    char msg[256];
-    snprintf(msg, sizeof(msg), 
-        COLOR_RED"%4d. Student (%-5s) out. Занято: %d/%d\n"COLOR_RESET,
-        s->studentID,
-        s->sex == man ? "man":"woman",
-        b->cabins_used, b->cabins_total);
-    
-    //printf("%s", msg);
-    send_to_client(s->client_socket, msg);
+    // Событие о выходе
+    wake |= bath_notify(b, s, PE_LEAVE, &urgent);
 
     // pthread_mutex_unlock(&b->dataMutex);
     // Сигнализируем всем ожидающим, что место освободилось
     pthread_cond_broadcast(&b->cond);
     pthread_mutex_unlock(&b->dataMutex);
+    if (wake) {
+        reactor_wake(urgent);
+    }
 }
 
 // Функция потока студента
 void* studentThread(void* arg) {
     St* s = (St*)arg;
+    double scale = s->job->params.scale;
+
+    // Приход по модели запроса (для ARRIVE_BATCH момент уже наступил)
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &s->arrive_at, NULL) == EINTR) {
+    }
     clock_gettime(CLOCK_MONOTONIC, &s->arrival);
     
-    if (enterBathroom(&b, s)) {
+    if (enterBathroom(s->bath, s)) {
         clock_gettime(CLOCK_MONOTONIC, &s->enter);
         // Имитация времени в душе (nanosleep)
+        double shower = s->timeForShower * scale;
         struct timespec ts;
-        ts.tv_sec = (time_t)s->timeForShower;
-        ts.tv_nsec = (long)((s->timeForShower - ts.tv_sec) * 1e9);
-        nanosleep(&ts, NULL);
-        leaveBathroom(&b, s);
+        ts.tv_sec = (time_t)shower;
+        ts.tv_nsec = (long)((shower - ts.tv_sec) * 1e9);
+        if (shower > 0) {
+            nanosleep(&ts, NULL);
+        }
+        leaveBathroom(s->bath, s);
     }
     clock_gettime(CLOCK_MONOTONIC, &s->leave);
     return 0;
 }
 
-// Генерация случайного числа
-int random_number(int min_num, int max_num) {
-    return (rand() % (max_num - min_num + 1)) + min_num;
+// Генерация случайного числа (генератор задания: результат воспроизводим по seed)
+int random_number(unsigned* seed, int min_num, int max_num) {
+    return (rand_r(seed) % (max_num - min_num + 1)) + min_num;
+}
+
+// Равномерное число в (0, 1)
+double random_unit(unsigned* seed) {
+    return (rand_r(seed) + 0.5) / ((double)RAND_MAX + 1.0);
 }
 
 // ============================================
-// ЗАПУСК СИМУЛЯЦИИ ДЛЯ КЛИЕНТА
+// ПАРАМЕТРЫ ЗАПРОСА
 // ============================================
 
 /**
- * @brief Запуск симуляции студентов для конкретного клиента
- * @param studLen - количество студентов
- * @param client_sock - сокет клиента для отправки результатов
- * 
- * Создает потоки студентов, запускает симуляцию и отправляет
- * результаты клиенту через сокет.
+ * @brief Параметры по умолчанию (поведение прежней команды N)
+ * @param p - параметры
  */
-void run_simulation(int studLen, int client_sock) {
-    St* students = (St*)malloc(studLen * sizeof(St));
-    
-    // Инициализация студентов
-    for (int i = 0; i < studLen; i++) {
-        int randTime = random_number(2, 5);
-        students[i].sex = (i % 2 == 0) ? man : woman;
-        students[i].timeForShower = (students[i].sex == woman) ? 2 * randTime : randTime;
-        students[i].studentID = i + 1;
-        students[i].client_socket = client_sock;
-    }
-
-    // Отправка информации о начале
-    char msg[256];
-    snprintf(msg, sizeof(msg), 
-        COLOR_RESET"\tНачало: студентов - %d, кабинок - %d, максимальная серия - %d\n"COLOR_RESET,
-        studLen, b.cabins_total, b.max_streak);
-    // printf("%s", msg);
-    send_to_client(client_sock, msg);
-
-    // Создание и запуск потоков
-    pthread_t* tid = (pthread_t*)malloc(studLen * sizeof(pthread_t));
-    Time total_begin, total_end;
+void sim_params_default(SimParams* p) {
+    memset(p, 0, sizeof(*p));
+    p->cabins = BATHROOM_CAPACITY;
+    p->max_streak = MAX_STREAK_FOR_STATE;
+    p->dist = DIST_LAB;
+    p->arrive = ARRIVE_BATCH;
+    p->verbose = 2;
+    p->scale = 1.0;
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &total_begin);
-    for (int i = 0; i < studLen; i++) {
-        pthread_create(&tid[i], NULL, studentThread, &students[i]);
+/**
+ * @brief Разбор параметров запроса
+ * @param s - строка после "dorm"/"submit": N [ключ=значение ...]
+ * @param p - параметры (заполнены по умолчанию)
+ * @param err - текст ошибки
+ * @param errlen - размер err
+ * @return true при успешном разборе
+ */
+bool sim_params_parse(const char* s, SimParams* p, char* err, size_t errlen) {
+    char buf[CMD_BUFFER_SIZE];
+    snprintf(buf, sizeof(buf), "%s", s);
+
+    char* save = NULL;
+    for (char* tok = strtok_r(buf, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save)) {
+        char* val = strchr(tok, '=');
+        char* end;
+
+        if (val == NULL) {
+            long n = strtol(tok, &end, 10);
+            if (*end != '\0' || p->students != 0) {
+                snprintf(err, errlen, "Ошибка: непонятный аргумент '%s'\n", tok);
+                return false;
+            }
+            p->students = n > 0 && n <= sim_max_students ? (int)n : -1;
+            continue;
+        }
+        *val++ = '\0';
+
+        if (strcmp(tok, "n") == 0) {
+            long n = strtol(val, &end, 10);
+            p->students = *end == '\0' && n > 0 && n <= sim_max_students ? (int)n : -1;
+        } else if (strcmp(tok, "cabins") == 0 || strcmp(tok, "streak") == 0) {
+            long n = strtol(val, &end, 10);
+            if (*end != '\0' || n < 1 || n > SIM_MAX_CABINS) {
+                snprintf(err, errlen, "Ошибка: %s - от 1 до %d\n", tok, SIM_MAX_CABINS);
+                return false;
+            }
+            if (tok[0] == 'c') {
+                p->cabins = n;
+            } else {
+                p->max_streak = n;
+            }
+        } else if (strcmp(tok, "seed") == 0) {
+            p->seed = strtoul(val, &end, 10);
+            p->seed_set = *end == '\0';
+            if (!p->seed_set) {
+                snprintf(err, errlen, "Ошибка: seed - целое без знака\n");
+                return false;
+            }
+        } else if (strcmp(tok, "dist") == 0) {
+            bool ok = true;
+            if (strcmp(val, "lab") == 0) {
+                p->dist = DIST_LAB;
+            } else if (sscanf(val, "fixed:%lf", &p->dist_a) == 1) {
+                p->dist = DIST_FIXED;
+                ok = p->dist_a >= 0;
+            } else if (sscanf(val, "uniform:%lf:%lf", &p->dist_a, &p->dist_b) == 2) {
+                p->dist = DIST_UNIFORM;
+                ok = p->dist_a >= 0 && p->dist_b >= p->dist_a;
+            } else if (sscanf(val, "exp:%lf", &p->dist_a) == 1) {
+                p->dist = DIST_EXP;
+                ok = p->dist_a > 0;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                snprintf(err, errlen,
+                         "Ошибка: dist=lab|fixed:T|uniform:A:B|exp:M (секунды)\n");
+                return false;
+            }
+        } else if (strcmp(tok, "arrive") == 0) {
+            bool ok = true;
+            if (strcmp(val, "batch") == 0) {
+                p->arrive = ARRIVE_BATCH;
+            } else if (sscanf(val, "poisson:%lf", &p->arrive_p) == 1) {
+                p->arrive = ARRIVE_POISSON;
+                ok = p->arrive_p > 0;
+            } else if (sscanf(val, "spread:%lf", &p->arrive_p) == 1) {
+                p->arrive = ARRIVE_SPREAD;
+                ok = p->arrive_p >= 0;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                snprintf(err, errlen,
+                         "Ошибка: arrive=batch|poisson:R (студентов/с)|spread:T (секунды)\n");
+                return false;
+            }
+        } else if (strcmp(tok, "verbose") == 0) {
+            long n = strtol(val, &end, 10);
+            if (*end != '\0' || n < 0 || n > 2) {
+                snprintf(err, errlen, "Ошибка: verbose - 0, 1 или 2\n");
+                return false;
+            }
+            p->verbose = n;
+        } else if (strcmp(tok, "scale") == 0) {
+            p->scale = strtod(val, &end);
+            if (*end != '\0' || !(p->scale >= 0 && p->scale <= 100)) {
+                snprintf(err, errlen, "Ошибка: scale - от 0 до 100\n");
+                return false;
+            }
+        } else {
+            snprintf(err, errlen, "Ошибка: неизвестный параметр '%s'\n", tok);
+            return false;
+        }
     }
 
-    // Ожидание завершения всех потоков
-    for (int i = 0; i < studLen; i++) {
-        pthread_join(tid[i], NULL);
+    if (p->students <= 0) {
+        snprintf(err, errlen, "Ошибка: число студентов 1-%d: [submit] [dorm] N "
+                 "[cabins=K streak=S seed=X dist=.. arrive=.. verbose=V scale=F]\n",
+                 sim_max_students);
+        return false;
     }
-    clock_gettime(CLOCK_MONOTONIC, &total_end);
-
-    // Отправка сообщения о завершении
-    snprintf(msg, sizeof(msg), 
-        COLOR_RESET"\t=======================Завершение======================\n"COLOR_RESET);
-    // printf("%s", msg);
-    send_to_client(client_sock, msg);
+    // Общее общежитие одно на всех: его кабинки и серия задаются при запуске
+    if (p->shared && (p->cabins != dorm.cabins_total || p->max_streak != dorm.max_streak)) {
+        snprintf(err, errlen, "Ошибка: cabins и streak общего общежития не меняются\n");
+        return false;
+    }
+    if (bench_mode) {
+        p->scale = 0;
+    }
+    return true;
+}
 
-    // Расчет статистики
-    double total_wait = 0.0, total_shower = 0.0;
-    for (int i = 0; i < studLen; i++) {
-        total_wait += timespec_diff(students[i].arrival, students[i].enter);
-        total_shower += timespec_diff(students[i].enter, students[i].leave);
+/**
+ * @brief Каноническая запись параметров (все поля, фиксированный порядок)
+ * @param p - параметры
+ * @param buf - буфер
+ * @param len - размер буфера
+ */
+void sim_params_format(const SimParams* p, char* buf, size_t len) {
+    char dist[64], arrive[48];
+
+    switch (p->dist) {
+    case DIST_FIXED: snprintf(dist, sizeof(dist), "fixed:%g", p->dist_a); break;
+    case DIST_UNIFORM: snprintf(dist, sizeof(dist), "uniform:%g:%g", p->dist_a, p->dist_b); break;
+    case DIST_EXP: snprintf(dist, sizeof(dist), "exp:%g", p->dist_a); break;
+    default: snprintf(dist, sizeof(dist), "lab"); break;
+    }
+    switch (p->arrive) {
+    case ARRIVE_POISSON: snprintf(arrive, sizeof(arrive), "poisson:%g", p->arrive_p); break;
+    case ARRIVE_SPREAD: snprintf(arrive, sizeof(arrive), "spread:%g", p->arrive_p); break;
+    default: snprintf(arrive, sizeof(arrive), "batch"); break;
     }
 
-    double total_time = timespec_diff(total_begin, total_end);
-    double utilization = total_shower / (total_time * b.cabins_total) * 100;
-    double avg_wait = total_wait / studLen;
+    snprintf(buf, len, "%s%d cabins=%u streak=%u seed=%u dist=%s arrive=%s verbose=%d scale=%g",
+             p->shared ? "dorm " : "", p->students, p->cabins, p->max_streak,
+             p->seed, dist, arrive, p->verbose, p->scale);
+}
 
-    // Отправка статистики
-    snprintf(msg, sizeof(msg), 
-        COLOR_RESET"Среднее время ожидания: %f\n"COLOR_RESET, avg_wait);
-    // printf("%s", msg);
-    send_to_client(client_sock, msg);
+/**
+ * @brief Время в душе по распределению запроса, секунды модели
+ * @param p - параметры
+ * @param sex - пол студента
+ * @param seed - генератор задания
+ */
+float sim_service_time(const SimParams* p, Sex sex, unsigned* seed) {
+    switch (p->dist) {
+    case DIST_FIXED:
+        return p->dist_a;
+    case DIST_UNIFORM:
+        return p->dist_a + (p->dist_b - p->dist_a) * random_unit(seed);
+    case DIST_EXP:
+        return -p->dist_a * log(random_unit(seed));
+    default: {
+        int randTime = random_number(seed, 2, 5);
+        return (sex == woman) ? 2 * randTime : randTime;
+    }
+    }
+}
+
+/**
+ * @brief Строка параметров задания в его вывод
+ * @param j - задание
+ */
+void job_emit_params(Job* j) {
+    char line[CMD_BUFFER_SIZE + 32], canon[CMD_BUFFER_SIZE];
+    sim_params_format(&j->params, canon, sizeof(canon));
+    snprintf(line, sizeof(line), "\tПараметры: %s\n", canon);
+    job_emit(j, line);
+}
+
+// ============================================
+// КЭШ РЕЗУЛЬТАТОВ: LRU С БЮДЖЕТОМ ПАМЯТИ
+// ============================================
+
+/**
+ * @brief Можно ли брать результат из кэша
+ * @param p - параметры
+ *
+ * Кэшируются только запросы с явным seed: без него клиент ждет новый
+ * прогон. Общее общежитие зависит от чужих симуляций и не кэшируется.
+ */
+bool sim_params_cacheable(const SimParams* p) {
+    return cache_budget > 0 && p->seed_set && !p->shared;
+}
+
+/**
+ * @brief Ключ кэша: версия модели и канонические параметры
+ * @param p - параметры
+ * @param buf - буфер
+ * @param len - размер буфера
+ */
+void cache_key(const SimParams* p, char* buf, size_t len) {
+    char canon[CMD_BUFFER_SIZE];
+    sim_params_format(p, canon, sizeof(canon));
+    snprintf(buf, len, "m%d %s", SIM_MODEL_VERSION, canon);
+}
+
+// FNV-1a
+uint32_t cache_hash(const char* key) {
+    uint32_t h = 2166136261u;
+    for (; *key; key++) {
+        h = (h ^ (uint8_t)*key) * 16777619u;
+    }
+    return h;
+}
+
+void cache_lru_unlink(CacheEntry* e) {
+    if (e->prev != NULL) e->prev->next = e->next; else cache_lru_head = e->next;
+    if (e->next != NULL) e->next->prev = e->prev; else cache_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+void cache_lru_push(CacheEntry* e) {
+    e->prev = NULL;
+    e->next = cache_lru_head;
+    if (cache_lru_head != NULL) cache_lru_head->prev = e; else cache_lru_tail = e;
+    cache_lru_head = e;
+}
+
+void cache_entry_free(CacheEntry* e) {
+    free(e->key);
+    free(e->events);
+    free(e);
+}
+
+/**
+ * @brief Удаление записи из таблицы и LRU (под cache_mutex)
+ * @param e - запись
+ */
+void cache_remove_locked(CacheEntry* e) {
+    CacheEntry** pp = &cache_table[e->hash % CACHE_BUCKETS];
+    while (*pp != e) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = e->hnext;
+    cache_lru_unlink(e);
+    cache_bytes -= e->bytes;
+    cache_entries--;
+    cache_entry_free(e);
+}
+
+CacheEntry* cache_find_locked(const char* key, uint32_t hash) {
+    for (CacheEntry* e = cache_table[hash % CACHE_BUCKETS]; e != NULL; e = e->hnext) {
+        if (e->hash == hash && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Запись кэша в файл
+ * @param f - файл
+ * @param e - запись
+ *
+ * Формат (big-endian, как в кадрах): "BTRC", u16 версия модели,
+ * u16 длина ключа, u32 число событий, ProtoStats начала и итога,
+ * ключ, события.
+ */
+void cache_write_record(FILE* f, const CacheEntry* e) {
+    uint8_t hdr[12 + 2 * PROTO_STATS_SIZE];
+    size_t klen = strlen(e->key);
+    memcpy(hdr, CACHE_FILE_MAGIC, 4);
+    proto_put16(hdr + 4, SIM_MODEL_VERSION);
+    proto_put16(hdr + 6, klen);
+    proto_put32(hdr + 8, e->nevents);
+    proto_stats_encode(hdr + 12, &e->start);
+    proto_stats_encode(hdr + 12 + PROTO_STATS_SIZE, &e->stats);
+    fwrite(hdr, 1, sizeof(hdr), f);
+    fwrite(e->key, 1, klen, f);
+    for (size_t i = 0; i < e->nevents; i++) {
+        uint8_t p[PROTO_EVENT_SIZE];
+        proto_event_encode(p, &e->events[i]);
+        fwrite(p, 1, sizeof(p), f);
+    }
+}
+
+/**
+ * @brief Добавление результата в кэш (под cache_mutex)
+ * @param key - ключ
+ * @param start - параметры начала
+ * @param stats - итог
+ * @param events - события (запись забирает массив себе)
+ * @param nevents - число событий
+ * @return запись или NULL, если результат больше бюджета
+ *
+ * Старые записи вытесняются с хвоста LRU, пока новая не уместится.
+ */
+CacheEntry* cache_put_locked(const char* key, const ProtoStats* start, const ProtoStats* stats,
+                             ProtoEvent* events, size_t nevents) {
+    size_t bytes = sizeof(CacheEntry) + strlen(key) + 1 + nevents * sizeof(ProtoEvent);
+    uint32_t hash = cache_hash(key);
+
+    CacheEntry* old = cache_find_locked(key, hash);
+    if (old != NULL) {
+        cache_remove_locked(old);
+    }
+    if (bytes > cache_budget) {
+        free(events);
+        return NULL;
+    }
+    while (cache_bytes + bytes > cache_budget && cache_lru_tail != NULL) {
+        cache_remove_locked(cache_lru_tail);
+        cache_evicted++;
+    }
+
+    CacheEntry* e = calloc(1, sizeof(CacheEntry));
+    e->key = strdup(key);
+    e->hash = hash;
+    e->start = *start;
+    e->stats = *stats;
+    e->events = events;
+    e->nevents = nevents;
+    e->bytes = bytes;
+    e->hnext = cache_table[hash % CACHE_BUCKETS];
+    cache_table[hash % CACHE_BUCKETS] = e;
+    cache_lru_push(e);
+    cache_bytes += bytes;
+    cache_entries++;
+    return e;
+}
+
+/**
+ * @brief Поиск результата в кэше с учетом попаданий и промахов
+ * @param key - ключ
+ * @return копия записи (освобождается cache_entry_free) или NULL
+ *
+ * Копия позволяет воспроизводить результат без cache_mutex:
+ * рабочие потоки в это время могут вытеснить оригинал.
+ */
+CacheEntry* cache_lookup(const char* key) {
+    uint32_t hash = cache_hash(key);
+    CacheEntry* copy = NULL;
+
+    pthread_mutex_lock(&cache_mutex);
+    CacheEntry* e = cache_find_locked(key, hash);
+    if (e != NULL) {
+        cache_hits++;
+        cache_lru_unlink(e);
+        cache_lru_push(e);
+
+        copy = malloc(sizeof(CacheEntry));
+        *copy = *e;
+        copy->key = strdup(e->key);
+        copy->events = malloc(e->nevents * sizeof(ProtoEvent) + 1);
+        memcpy(copy->events, e->events, e->nevents * sizeof(ProtoEvent));
+    } else {
+        cache_misses++;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return copy;
+}
+
+/**
+ * @brief Сохранение результата завершенного задания (рабочий поток)
+ * @param j - задание
+ */
+void cache_store_job(Job* j) {
+    if (j->rec_overflow) {
+        free(j->rec);
+    } else {
+        char key[CMD_BUFFER_SIZE + 16];
+        cache_key(&j->params, key, sizeof(key));
+
+        pthread_mutex_lock(&cache_mutex);
+        CacheEntry* e = cache_put_locked(key, &j->rec_start, &j->rec_stats, j->rec, j->rec_len);
+        if (e != NULL && cache_file != NULL) {
+            cache_write_record(cache_file, e);
+            fflush(cache_file);
+        }
+        pthread_mutex_unlock(&cache_mutex);
+    }
+    j->rec = NULL;
+    j->rec_len = j->rec_cap = 0;
+}
+
+/**
+ * @brief Воспроизведение результата из кэша в вывод задания
+ * @param j - задание (в очередь не ставилось)
+ * @param e - копия записи
+ */
+void cache_replay(Job* j, const CacheEntry* e) {
+    job_emit_stats(j, FR_START, &e->start);
+    job_emit_params(j);
+
+    bool wake = false, urgent = false;
+    for (size_t i = 0; i < e->nevents; i++) {
+        wake |= job_emit_event_deferred(j, &e->events[i], &urgent);
+    }
+    if (wake) {
+        reactor_wake(urgent);
+    }
+
+    job_emit_stats(j, FR_STATS, &e->stats);
+}
+
+/**
+ * @brief Загрузка кэша из файла и открытие его для дозаписи
+ * @param path - файл (-P)
+ *
+ * Записи другой версии модели и оборванный хвост пропускаются.
+ * После загрузки файл переписывается только действующими записями
+ * (от старых к свежим), поэтому журнал не растет без предела.
+ */
+void cache_open(const char* path) {
+    FILE* f = fopen(path, "rb");
+    unsigned long loaded = 0;
+
+    pthread_mutex_lock(&cache_mutex);
+    while (f != NULL) {
+        uint8_t hdr[12 + 2 * PROTO_STATS_SIZE];
+        if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, CACHE_FILE_MAGIC, 4) != 0) {
+            break;
+        }
+        uint16_t version = proto_get16(hdr + 4);
+        uint16_t klen = proto_get16(hdr + 6);
+        uint32_t nevents = proto_get32(hdr + 8);
+        if (nevents > CACHE_EVENTS_MAX) {
+            break;
+        }
+
+        char* key = malloc(klen + 1);
+        ProtoEvent* events = malloc(nevents * sizeof(ProtoEvent) + 1);
+        bool ok = fread(key, 1, klen, f) == klen;
+        key[klen] = '\0';
+        for (uint32_t i = 0; ok && i < nevents; i++) {
+            uint8_t p[PROTO_EVENT_SIZE];
+            ok = fread(p, 1, sizeof(p), f) == sizeof(p);
+            proto_event_decode(p, &events[i]);
+        }
+        if (!ok) {
+            free(key);
+            free(events);
+            break;
+        }
+
+        if (version == SIM_MODEL_VERSION) {
+            ProtoStats start, stats;
+            proto_stats_decode(hdr + 12, &start);
+            proto_stats_decode(hdr + 12 + PROTO_STATS_SIZE, &stats);
+            cache_put_locked(key, &start, &stats, events, nevents);
+            loaded++;
+        } else {
+            free(events);
+        }
+        free(key);
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+
+    cache_file = fopen(path, "wb");
+    if (cache_file == NULL) {
+        perror("Файл кэша");
+    } else {
+        for (CacheEntry* e = cache_lru_tail; e != NULL; e = e->prev) {
+            cache_write_record(cache_file, e);
+        }
+        fflush(cache_file);
+    }
+    printf("Кэш результатов: загружено %lu записей из %s (%lu в памяти, %zu КиБ)\n",
+           loaded, path, cache_entries, cache_bytes / 1024);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+// ============================================
+// ЗАПУСК СИМУЛЯЦИИ ДЛЯ КЛИЕНТА
+// ============================================
+
+/**
+ * @brief Запуск симуляции студентов для конкретного клиента
+ * @param job - задание (параметры; клиент или буфер результата)
+ * @param b - ванная симуляции (отдельная из пула или общее общежитие)
+ * 
+ * Создает потоки студентов, запускает симуляцию и отправляет
+ * результаты через вывод задания. Времена в душе и моменты прихода
+ * берутся из генератора задания, поэтому одинаковый seed дает
+ * одинаковый набор студентов.
+ */
+void run_simulation(Job* job, Br* b) {
+    const SimParams* p = &job->params;
+    int studLen = p->students;
+    unsigned seed = p->seed;
+    St* students = (St*)malloc(studLen * sizeof(St));
+    double* offsets = (double*)malloc(studLen * sizeof(double));
+    
+    // Инициализация студентов
+    double t = 0;
+    for (int i = 0; i < studLen; i++) {
+        students[i].sex = (i % 2 == 0) ? man : woman;
+        students[i].timeForShower = sim_service_time(p, students[i].sex, &seed);
+        students[i].studentID = i + 1;
+        students[i].job = job;
+        students[i].bath = b;
+
+        if (p->arrive == ARRIVE_POISSON) {
+            t += -log(random_unit(&seed)) / p->arrive_p;
+        } else if (p->arrive == ARRIVE_SPREAD) {
+            t = p->arrive_p * random_unit(&seed);
+        }
+        offsets[i] = t * p->scale;
+    }
+
+
+    // Отправка информации о начале
+    ProtoStats st = {
+        .students = studLen,
+        .cabins_total = b->cabins_total,
+        .max_streak = b->max_streak,
+        .shared = b->shared,
+    };
+    job_emit_stats(job, FR_START, &st);
+    job_emit_params(job);
+
+    // Создание и запуск потоков. Студентов может быть тысячи:
+    // стек потока уменьшен, а при отказе pthread_create студент
+    // выполняется прямо в рабочем потоке
+    pthread_t* tid = (pthread_t*)malloc(studLen * sizeof(pthread_t));
+    bool* started = (bool*)malloc(studLen * sizeof(bool));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STUDENT_STACK);
+    Time total_begin, total_end;
+
+    clock_gettime(CLOCK_MONOTONIC, &total_begin);
+    for (int i = 0; i < studLen; i++) {
+        long ns = total_begin.tv_nsec + (long)((offsets[i] - (long)offsets[i]) * 1e9);
+        students[i].arrive_at.tv_sec = total_begin.tv_sec + (time_t)offsets[i] + ns / 1000000000L;
+        students[i].arrive_at.tv_nsec = ns % 1000000000L;
+
+        started[i] = pthread_create(&tid[i], &attr, studentThread, &students[i]) == 0;
+        if (!started[i]) {
+            studentThread(&students[i]);
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    // Ожидание завершения всех потоков
+    for (int i = 0; i < studLen; i++) {
+        if (started[i]) {
+            pthread_join(tid[i], NULL);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &total_end);
+
+    // Расчет статистики
+    double total_wait = 0.0, total_shower = 0.0;
+    for (int i = 0; i < studLen; i++) {
+        total_wait += timespec_diff(students[i].arrival, students[i].enter);
+        total_shower += timespec_diff(students[i].enter, students[i].leave);
+    }
+
+    double total_time = timespec_diff(total_begin, total_end);
+    double utilization = total_shower / (total_time * b->cabins_total) * 100;
+    double avg_wait = total_wait / studLen;
+
+    // Отправка статистики (строка завершения, ожидание, утилизация)
+    st.avg_wait_us = (uint32_t)(avg_wait * 1e6);
+    st.utilization_bp = (uint32_t)(utilization * 100);
+    st.total_ms = (uint32_t)(total_time * 1000);
+    job_emit_stats(job, FR_STATS, &st);
+
+    free(students);
+    free(offsets);
+    free(started);
+    free(tid);
+}
+
+// ============================================
+// ОЧЕРЕДЬ ЗАДАНИЙ И РАБОЧИЕ ПОТОКИ
+// ============================================
+
+/**
+ * @brief Оценка, через сколько секунд стоит повторить отклоненный запрос
+ *
+ * Вызывается под jobs_mutex: время на разбор очереди текущим пулом.
+ */
+int job_retry_after(void) {
+    double avg = job_avg_sec > 0 ? job_avg_sec : 1.0;
+    int sec = (int)(avg * (job_depth / job_workers + 1) + 0.999);
+    return sec < 1 ? 1 : sec;
+}
+
+/**
+ * @brief Постановка задания в очередь (только реактор)
+ * @param params - параметры симуляции (seed выбирается здесь, если не задан)
+ * @param client - сессия для потокового вывода или NULL
+ * @param cached - результат есть в кэше: задание сразу завершено
+ *                 и в очередь не ставится
+ * @param info - позиция в очереди или, при отказе, секунды до повтора
+ * @return задание или NULL, если очередь заполнена
+ *
+ * Контроль допуска: при заполненной очереди запрос отклоняется сразу,
+ * а не копится, поэтому перегрузка выражается в отказах с оценкой
+ * времени повтора, а не в неограниченном росте задержки и числа потоков.
+ */
+Job* job_submit(const SimParams* params, Client* client, bool cached, int* info) {
+    pthread_mutex_lock(&jobs_mutex);
+
+    Job** slot = &job_table[job_next_id % JOB_HISTORY];
+    bool slot_busy = *slot != NULL &&
+                     ((*slot)->state == JOB_QUEUED || (*slot)->state == JOB_RUNNING);
+
+    if ((!cached && job_depth >= job_queue_limit) || slot_busy) {
+        job_rejected++;
+        *info = job_retry_after();
+        pthread_mutex_unlock(&jobs_mutex);
+        return NULL;
+    }
+
+    // Место в таблице занимает давно завершенное задание - освобождаем
+    if (*slot != NULL) {
+        pthread_mutex_destroy(&(*slot)->out_mutex);
+        free((*slot)->result);
+        free((*slot)->rec);
+        free(*slot);
+    }
+
+    Job* j = calloc(1, sizeof(Job));
+    j->id = job_next_id++;
+    j->params = *params;
+    j->cacheable = !cached && sim_params_cacheable(params);
+    if (!j->params.seed_set) {
+        j->params.seed = (unsigned)time(NULL) ^ (unsigned)(j->id * 2654435761u);
+        j->params.seed_set = true;
+    }
+    j->client = client;
+    j->state = cached ? JOB_DONE : JOB_QUEUED;
+    pthread_mutex_init(&j->out_mutex, NULL);
+    *slot = j;
+
+    if (cached) {
+        *info = 0;
+        pthread_mutex_unlock(&jobs_mutex);
+        return j;
+    }
+
+    if (job_tail != NULL) {
+        job_tail->next = j;
+    } else {
+        job_head = j;
+    }
+    job_tail = j;
+    job_depth++;
+    *info = job_depth;
+
+    pthread_cond_signal(&jobs_cond);
+    pthread_mutex_unlock(&jobs_mutex);
+    return j;
+}
+
+/**
+ * @brief Поиск задания по номеру (под jobs_mutex)
+ * @param id - номер задания
+ * @return задание или NULL, если номер неизвестен или уже вытеснен
+ */
+Job* job_find(unsigned long id) {
+    Job* j = job_table[id % JOB_HISTORY];
+    return (j != NULL && j->id == id) ? j : NULL;
+}
+
+/**
+ * @brief Сообщение реактору о завершении симуляции клиента
+ * @param c - клиент
+ *
+ * Завершение отправляется сразу, без ожидания таймера.
+ */
+void job_finish_notify(Client* c) {
+    pthread_mutex_lock(&c->out_mutex);
+    c->sim_done = true;
+    if (!c->queued) {
+        c->queued = true;
+        pending_push(c);
+    }
+    pthread_mutex_unlock(&c->out_mutex);
+    reactor_wake(true);
+}
+
+/**
+ * @brief Рабочий поток пула симуляций
+ * @param arg - не используется
+ *
+ * Берет задания из очереди по одному. Для потокового задания по окончании
+ * сообщает реактору, что симуляция завершена; после этого к клиенту
+ * больше не обращается (реактор держит за него ссылку до этого момента).
+ */
+void* sim_worker(void* arg) {
+    (void)arg;
+
+    while (1) {
+        pthread_mutex_lock(&jobs_mutex);
+        while (job_head == NULL) {
+            pthread_cond_wait(&jobs_cond, &jobs_mutex);
+        }
+        Job* j = job_head;
+        job_head = j->next;
+        if (job_head == NULL) {
+            job_tail = NULL;
+        }
+        j->next = NULL;
+        job_depth--;
+        job_running++;
+        j->state = JOB_RUNNING;
+        pthread_mutex_unlock(&jobs_mutex);
+
+        // Клиент отключился, пока задание стояло в очереди: не запускаем
+        Client* c = j->client;
+        bool cancelled = false;
+        if (c != NULL) {
+            pthread_mutex_lock(&c->out_mutex);
+            cancelled = c->dead;
+            pthread_mutex_unlock(&c->out_mutex);
+        }
+
+        Time begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (!cancelled) {
+            Br* br = j->params.shared ? &dorm : bath_acquire();
+            if (br == NULL) {
+                job_emit(j, "Ошибка: нет памяти под ванную\n");
+            } else {
+                if (br != &dorm) {
+                    br->cabins_total = j->params.cabins;
+                    br->max_streak = j->params.max_streak;
+                }
+                run_simulation(j, br);
+                if (br != &dorm) {
+                    bath_release(br);
+                }
+                if (j->cacheable) {
+                    cache_store_job(j);
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        pthread_mutex_lock(&jobs_mutex);
+        j->state = cancelled ? JOB_CANCELLED : JOB_DONE;
+        j->client = NULL;
+        job_running--;
+        if (!cancelled) {
+            double sec = timespec_diff(begin, end);
+            job_avg_sec = job_completed == 0 ? sec : 0.8 * job_avg_sec + 0.2 * sec;
+            job_completed++;
+        }
+        pthread_mutex_unlock(&jobs_mutex);
+
+        if (c != NULL) {
+            job_finish_notify(c);
+        }
+    }
+    return NULL;
+}
+
+// ============================================
+// РЕАКТОР: ОБРАБОТКА ПОДКЛЮЧЕНИЙ
+// ============================================
+
+// Клиенты к освобождению: освобождаются в конце итерации реактора,
+// когда в массиве событий epoll на них уже нет ссылок
+Client* free_list = NULL;
+
+/**
+ * @brief Освобождение клиента, если на него больше никто не ссылается
+ * @param c - клиент
+ */
+void client_maybe_free(Client* c) {
+    if (c->dead && c->refs == 0 && !c->queued) {
+        c->refs = -1;
+        c->next_pending = free_list;
+        free_list = c;
+    }
+}
+
+/**
+ * @brief Освобождение отложенных клиентов
+ */
+void reactor_free_clients(void) {
+    while (free_list != NULL) {
+        Client* c = free_list;
+        free_list = c->next_pending;
+        client_release(c);
+    }
+}
+
+/**
+ * @brief Закрытие соединения клиента
+ * @param c - клиент
+ *
+ * Если симуляция еще идет, структура клиента живет до ее завершения,
+ * а весь ее вывод отбрасывается.
+ */
+void client_close(Client* c) {
+    if (c->dead) {
+        return;
+    }
+
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_client_close(c);
+    }
+#endif
+    if (epoll_fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        reactor_syscalls++;
+    }
+
+    pthread_mutex_lock(&clients_mutex);
+    c->listed = false;
+    num_clients--;
+    pthread_mutex_unlock(&clients_mutex);
+
+    pthread_mutex_lock(&c->out_mutex);
+    c->dead = true;
+    out_free_chain(c->out_head);
+    c->out_head = c->out_tail = NULL;
+    c->out_bytes = 0;
+    pthread_mutex_unlock(&c->out_mutex);
+#ifdef USE_IO_URING
+    bool sending = c->sends > 0;    // блоки SEND в кольце освободит их завершение
+#else
+    bool sending = false;
+#endif
+    if (!sending) {
+        out_free_chain(c->send_head);
+        c->send_head = c->send_tail = NULL;
+    }
+
+    close(c->fd);
+    reactor_syscalls++;
+    if (!quiet) {
+        printf("Клиент отключился. Активных: %d\n", num_clients);
+    }
+
+    c->refs--;
+    client_maybe_free(c);
+}
+
+/**
+ * @brief Отправка накопленного выходного буфера
+ * @param c - клиент
+ *
+ * Цепочка блоков забирается из-под out_mutex целиком, а отправляется
+ * уже без блокировки: потоки симуляции не ждут системного вызова.
+ * sendmsg() с вектором блоков (writev с флагами MSG_NOSIGNAL и
+ * MSG_DONTWAIT) отправляет до OUT_IOV_MAX блоков за вызов;
+ * то, что не поместилось в сокет, остается до события EPOLLOUT.
+ * На io_uring цепочку отправляют SEND в кольце (uring_client_send).
+ */
+void client_flush(Client* c) {
+    bool failed = false;
+    size_t sent = 0;
+
+    pthread_mutex_lock(&c->out_mutex);
+    if (c->out_head != NULL) {
+        if (c->send_tail != NULL) {
+            c->send_tail->next = c->out_head;
+        } else {
+            c->send_head = c->out_head;
+        }
+        c->send_tail = c->out_tail;
+        c->out_head = c->out_tail = NULL;
+        c->out_bytes = 0;
+    }
+    c->kicked = false;
+    pthread_mutex_unlock(&c->out_mutex);
+
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_client_send(c);
+        return;
+    }
+#endif
+
+    while (c->send_head != NULL) {
+        struct iovec iov[OUT_IOV_MAX];
+        int cnt = 0;
+        for (OutBlock* blk = c->send_head; blk != NULL && cnt < OUT_IOV_MAX; blk = blk->next) {
+            iov[cnt].iov_base = blk->data + blk->off;
+            iov[cnt].iov_len = blk->len - blk->off;
+            cnt++;
+        }
+
+        struct msghdr mh = { .msg_iov = iov, .msg_iovlen = cnt };
+        ssize_t n = sendmsg(c->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+        reactor_syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = !(errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
+        out_calls++;
+        out_sent += n;
+        sent += n;
+
+        // Освобождаем полностью отправленные блоки
+        while (n > 0) {
+            OutBlock* blk = c->send_head;
+            size_t left = blk->len - blk->off;
+            if ((size_t)n < left) {
+                blk->off += n;
+                break;
+            }
+            n -= left;
+            c->send_head = blk->next;
+            free(blk);
+        }
+        if (c->send_head == NULL) {
+            c->send_tail = NULL;
+        } else if (c->send_head->off > 0) {
+            // Сокет заполнен: ждем EPOLLOUT
+            break;
+        }
+    }
+
+    if (sent > 0) {
+        pthread_mutex_lock(&c->out_mutex);
+        c->backlog -= sent;
+        pthread_mutex_unlock(&c->out_mutex);
+    }
+
+    if (failed || (c->send_head == NULL && c->state == CONN_CLOSING)) {
+        client_close(c);
+    }
+}
+
+/**
+ * @brief Типизированный ответ клиенту из реактора
+ * @param c - клиент
+ * @param type - тип кадра в двоичном режиме
+ * @param data - нагрузка (в текстовом режиме отправляется как есть)
+ * @param len - длина нагрузки
+ */
+void client_reply_typed(Client* c, uint8_t type, const void* data, size_t len) {
+    pthread_mutex_lock(&c->out_mutex);
+    out_append_msg(c, type, data, len);
+    pthread_mutex_unlock(&c->out_mutex);
+    client_flush(c);
+}
+
+/**
+ * @brief Ответ клиенту из реактора (буфер + немедленная попытка отправки)
+ * @param c - клиент
+ * @param msg - сообщение
+ */
+void client_reply(Client* c, const char* msg) {
+    client_reply_typed(c, FR_TEXT, msg, strlen(msg));
+}
+
+/**
+ * @brief Отправка сигнала готовности SERVER_READY
+ * @param c - клиент
+ */
+void client_ready(Client* c) {
+    c->state = CONN_AWAIT_COUNT;
+    if (c->binary) {
+        client_reply_typed(c, FR_READY, NULL, 0);
+    } else {
+        client_reply(c, "SERVER_READY: Отправьте количество студентов или quit\n");
+    }
+}
+
+/**
+ * @brief Сообщение об ошибке команды (FR_ERROR в двоичном режиме)
+ * @param c - клиент
+ * @param msg - текст ошибки
+ */
+void client_error(Client* c, const char* msg) {
+    client_reply_typed(c, FR_ERROR, msg, strlen(msg));
+}
+
+/**
+ * @brief Ответ на запрос состояния задания (status/result)
+ * @param c - клиент
+ * @param id - номер задания
+ * @param want_result - отправить сохраненный вывод, если задание завершено
+ *
+ * Задания создает и освобождает только реактор, поэтому завершенное
+ * задание можно читать после снятия jobs_mutex.
+ */
+void client_job_query(Client* c, unsigned long id, bool want_result) {
+    char response[CMD_BUFFER_SIZE];
+
+    pthread_mutex_lock(&jobs_mutex);
+    Job* j = job_find(id);
+    JobState state = j ? j->state : JOB_CANCELLED;
+    int pos = 0;
+    if (j != NULL && state == JOB_QUEUED) {
+        for (Job* q = job_head; q != NULL; q = q->next) {
+            pos++;
+            if (q == j) {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+
+    if (j == NULL) {
+        snprintf(response, sizeof(response), "Задание #%lu: не найдено\n", id);
+    } else if (state == JOB_QUEUED) {
+        snprintf(response, sizeof(response), "Задание #%lu: в очереди, позиция %d\n", id, pos);
+    } else if (state == JOB_RUNNING) {
+        snprintf(response, sizeof(response), "Задание #%lu: выполняется\n", id);
+    } else if (state == JOB_CANCELLED) {
+        snprintf(response, sizeof(response), "Задание #%lu: отменено\n", id);
+    } else if (!want_result) {
+        snprintf(response, sizeof(response), "Задание #%lu: готово\n", id);
+    } else {
+        pthread_mutex_lock(&c->out_mutex);
+        if (j->result_len > 0) {
+            out_append_msg(c, FR_TEXT, j->result, j->result_len);
+        } else {
+            const char* none = "(вывод отправлен в сессию клиента)\n";
+            out_append_msg(c, FR_TEXT, none, strlen(none));
+        }
+        pthread_mutex_unlock(&c->out_mutex);
+        snprintf(response, sizeof(response), "Результат задания #%lu завершен.\n", id);
+    }
+    client_reply(c, response);
+}
+
+/**
+ * @brief Обработка одной команды клиента в состоянии CONN_AWAIT_COUNT
+ * @param c - клиент
+ * @param cmd - команда: [submit] [dorm] N [параметры], status ID,
+ *              result ID, proto bin V или quit/exit
+ */
+void client_command(Client* c, const char* cmd) {
+    char response[CMD_BUFFER_SIZE];
+    reactor_cmds++;
+
+    // Проверка на quit
+    if (strncmp(cmd, "quit", 4) == 0 ||
+        strncmp(cmd, "exit", 4) == 0) {
+        c->state = CONN_CLOSING;
+        const char* bye = "Отключение...\n";
+        client_reply_typed(c, FR_BYE, bye, strlen(bye));
+        return;
+    }
+
+    // "proto bin V" - переход на двоичные кадры (только из текстового режима)
+    if (strncmp(cmd, PROTO_HELLO_CMD, strlen(PROTO_HELLO_CMD)) == 0) {
+        int version = atoi(cmd + strlen(PROTO_HELLO_CMD));
+        if (c->binary || version != PROTO_VERSION) {
+            snprintf(response, sizeof(response),
+                     "Ошибка: версия протокола %d не поддерживается (есть %d)\n",
+                     version, PROTO_VERSION);
+            client_error(c, response);
+        } else {
+            c->binary = true;
+            uint8_t v = PROTO_VERSION;
+            client_reply_typed(c, FR_HELLO, &v, 1);
+        }
+        if (!c->dead) {
+            client_ready(c);
+        }
+        return;
+    }
+
+    // "status ID" / "result ID" - опрос отложенного задания
+    if (strncmp(cmd, "status", 6) == 0 || strncmp(cmd, "result", 6) == 0) {
+        client_job_query(c, strtoul(cmd + 6, NULL, 10), cmd[0] == 'r');
+        if (!c->dead) {
+            client_ready(c);
+        }
+        return;
+    }
+
+    // "submit N" - задание без потокового вывода, номер возвращается сразу
+    bool detached = false;
+    if (strncmp(cmd, "submit", 6) == 0) {
+        detached = true;
+        cmd += 6;
+        cmd += strspn(cmd, " ");
+    }
+
+    // "dorm N" - симуляция в общем общежитии вместе с другими клиентами
+    SimParams params;
+    sim_params_default(&params);
+    params.shared = dorm_default;
+    if (strncmp(cmd, "dorm", 4) == 0) {
+        params.shared = true;
+        cmd += 4;
+    }
+
+    // Параметры после N: cabins=K streak=S seed=X dist=... arrive=... verbose=V scale=F
+    if (sim_params_parse(cmd, &params, response, sizeof(response))) {
+        int studLen = params.students;
+
+        // Повтор запроса с тем же seed отдается из кэша без запуска потоков
+        CacheEntry* hit = NULL;
+        if (sim_params_cacheable(&params)) {
+            char key[CMD_BUFFER_SIZE + 16];
+            cache_key(&params, key, sizeof(key));
+            hit = cache_lookup(key);
+        }
+
+        // Симуляцию выполняет пул рабочих потоков, реактор продолжает
+        // обслуживать остальных клиентов
+        int info;
+        Job* j = job_submit(&params, detached ? NULL : c, hit != NULL, &info);
+        if (j == NULL) {
+            if (hit != NULL) {
+                cache_entry_free(hit);
+            }
+            if (c->binary) {
+                uint8_t retry[4];
+                proto_put32(retry, info);
+                client_reply_typed(c, FR_BUSY, retry, sizeof(retry));
+            } else {
+                snprintf(response, sizeof(response),
+                         "BUSY: очередь заполнена, повторите через %d с\n", info);
+                client_reply(c, response);
+            }
+            if (!c->dead) {
+                client_ready(c);
+            }
+            return;
+        }
+
+        if (detached && hit != NULL) {
+            cache_replay(j, hit);
+            cache_entry_free(hit);
+            snprintf(response, sizeof(response),
+                     "Задание #%lu готово: %d студентов, результат из кэша\n", j->id, studLen);
+            client_reply(c, response);
+            if (!c->dead) {
+                client_ready(c);
+            }
+            return;
+        }
+
+        if (detached) {
+            snprintf(response, sizeof(response),
+                     "Задание #%lu принято: %d студентов, позиция в очереди %d\n",
+                     j->id, studLen, info);
+            client_reply(c, response);
+            if (!c->dead) {
+                client_ready(c);
+            }
+            return;
+        }
+
+        c->state = CONN_SIMULATING;
+        c->sim_done = false;
+        c->refs++;
+
+        if (hit != NULL) {
+            snprintf(response, sizeof(response),
+                     "Принято: %d студентов. Задание #%lu, результат из кэша\n", studLen, j->id);
+            client_reply(c, response);
+            cache_replay(j, hit);
+            cache_entry_free(hit);
+            j->client = NULL;
+            job_finish_notify(c);
+            return;
+        }
+
+        snprintf(response, sizeof(response),
+                 "Принято: %d студентов. Задание #%lu, позиция в очереди %d\n",
+                 studLen, j->id, info);
+        client_reply(c, response);
+    } else {
+        client_error(c, response);
+        if (!c->dead) {
+            client_ready(c);
+        }
+    }
+}
+
+/**
+ * @brief Разбор входного буфера на команды
+ * @param c - клиент
+ *
+ * Команды разделяются переводом строки; клиент из ЛР4 отправляет число
+ * без перевода строки, поэтому остаток буфера тоже считается командой.
+ * В двоичном режиме команды приходят кадрами FR_CMD; кадр с неверной
+ * версией или не помещающийся во входной буфер закрывает соединение.
+ */
+void client_process_input(Client* c) {
+    while (!c->dead && c->state == CONN_AWAIT_COUNT && c->in_len > 0) {
+        char cmd[CMD_BUFFER_SIZE];
+
+        if (c->binary) {
+            uint8_t type;
+            uint32_t plen;
+            // plen известна и при rc == 0: кадр, который не поместится
+            // в буфер, отвергается до приема нагрузки целиком
+            int rc = proto_parse((const uint8_t*)c->in, c->in_len, &type, &plen);
+            if (rc < 0 || PROTO_HDR_SIZE + plen > sizeof(c->in) - 1) {
+                client_close(c);
+                return;
+            }
+            if (rc == 0) {
+                break;
+            }
+
+            memcpy(cmd, c->in + PROTO_HDR_SIZE, plen);
+            cmd[plen] = '\0';
+            size_t len = PROTO_HDR_SIZE + plen;
+            memmove(c->in, c->in + len, c->in_len - len);
+            c->in_len -= len;
+
+            if (type == FR_CMD) {
+                client_command(c, cmd);
+            }
+            continue;
+        }
+
+        char* nl = memchr(c->in, '\n', c->in_len);
+        size_t len = nl ? (size_t)(nl - c->in) + 1 : c->in_len;
+
+        memcpy(cmd, c->in, len);
+        cmd[len] = '\0';
+        cmd[strcspn(cmd, "\r\n")] = '\0';
+
+        memmove(c->in, c->in + len, c->in_len - len);
+        c->in_len -= len;
+
+        client_command(c, cmd);
+    }
+}
+
+/**
+ * @brief Освобождение места в заполненном входном буфере
+ * @param c - клиент
+ * @return false, если соединение закрыто
+ */
+bool client_in_room(Client* c) {
+    while (!c->dead && c->in_len == sizeof(c->in) - 1) {
+        if (c->state != CONN_AWAIT_COUNT) {
+            // Во время симуляции команды не принимаются: лишнее отбрасываем.
+            // В двоичном режиме это разорвало бы кадры - закрываем
+            if (c->binary) {
+                client_close(c);
+                return false;
+            }
+            c->in_len = 0;
+        } else {
+            client_process_input(c);
+        }
+    }
+    return !c->dead;
+}
+
+/**
+ * @brief Чтение всех доступных данных сокета (edge-triggered)
+ * @param c - клиент
+ */
+void client_on_readable(Client* c) {
+    while (client_in_room(c)) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len, 0);
+        reactor_syscalls++;
+        if (n > 0) {
+            c->in_len += n;
+        } else if (n == 0) {
+            // Клиент закрыл соединение
+            client_close(c);
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            client_close(c);
+            return;
+        }
+    }
+
+    client_process_input(c);
+}
+
+/**
+ * @brief Раскладка рассылок из кольца по буферам клиентов
+ *
+ * Выполняется реактором. Клиенту, отставшему больше чем на
+ * OUT_BCAST_LIMIT, рассылка не ставится; когда он догонит, получит одно
+ * сообщение с числом пропущенных рассылок вместо всех.
+ */
+void reactor_fanout(void) {
+    ProtoEvent e;
+    char msg[256];
+    uint8_t frame[PROTO_EVENT_SIZE];
+
+    while (1) {
+        pthread_mutex_lock(&bcast_mutex);
+        if (bcast_head == bcast_tail) {
+            pthread_mutex_unlock(&bcast_mutex);
+            break;
+        }
+        e = bcast_ring[bcast_tail % BCAST_RING];
+        bcast_tail++;
+        pthread_mutex_unlock(&bcast_mutex);
+
+        // Оба представления готовятся один раз на рассылку
+        format_event(&e, msg, sizeof(msg));
+        size_t len = strlen(msg);
+        proto_event_encode(frame, &e);
+        pthread_mutex_lock(&clients_mutex);
+        for (int i = 0; i < client_high; i++) {
+            Client* c = client_at(i);
+            if (!c->listed) {
+                continue;
+            }
+
+            pthread_mutex_lock(&c->out_mutex);
+            if (c->overflow || c->backlog > OUT_BCAST_LIMIT) {
+                c->bcast_dropped++;
+                bcast_dropped++;
+            } else {
+                if (c->bcast_dropped > 0) {
+                    if (c->binary) {
+                        uint8_t cnt[4];
+                        proto_put32(cnt, c->bcast_dropped);
+                        out_append_msg(c, FR_DROPPED, cnt, sizeof(cnt));
+                    } else {
+                        char note[96];
+                        snprintf(note, sizeof(note),
+                                 "\t[пропущено рассылок: %u]\n", c->bcast_dropped);
+                        out_append(c, note, strlen(note));
+                    }
+                    c->bcast_dropped = 0;
+                }
+                if (c->binary) {
+                    out_append_msg(c, FR_EVENT, frame, sizeof(frame));
+                } else {
+                    out_append(c, msg, len);
+                }
+                if (!c->queued) {
+                    c->queued = true;
+                    pending_push(c);
+                }
+            }
+            pthread_mutex_unlock(&c->out_mutex);
+        }
+        pthread_mutex_unlock(&clients_mutex);
+    }
+}
+
+/**
+ * @brief Обработка очереди уведомлений от потоков симуляции
+ *
+ * Сначала раскладываются рассылки, затем отправляется вывод всех
+ * клиентов из очереди; переполненные клиенты отключаются.
+ */
+void reactor_drain_pending(void) {
+    reactor_fanout();
+
+    pthread_mutex_lock(&pending_mutex);
+    Client* list = pending_head;
+    pending_head = NULL;
+    pthread_mutex_unlock(&pending_mutex);
+
+    while (list != NULL) {
+        Client* c = list;
+        list = c->next_pending;
+
+        pthread_mutex_lock(&c->out_mutex);
+        c->queued = false;
+        c->kicked = false;
+        bool done = c->sim_done;
+        c->sim_done = false;
+        bool overflow = c->overflow;
+        pthread_mutex_unlock(&c->out_mutex);
+
+        if (done) {
+            c->refs--;
+        }
+
+        if (overflow && !c->dead) {
+            slow_closed++;
+            if (!quiet) {
+                printf("Клиент не успевает читать вывод: отключен\n");
+            }
+            client_close(c);
+        }
+
+        if (c->dead) {
+            client_maybe_free(c);
+            continue;
+        }
+
+        if (done) {
+            const char* done_msg = "Симуляция завершена.\n";
+            client_reply_typed(c, FR_DONE, done_msg, strlen(done_msg));
+            if (!c->dead) {
+                client_ready(c);
+                client_process_input(c);
+            }
+        } else {
+            client_flush(c);
+        }
+    }
+}
+
+/**
+ * @brief Регистрация принятого соединения и сигнал готовности
+ * @param new_socket - неблокирующий сокет клиента
+ * @param address - адрес клиента (NULL - неизвестен)
+ * @param local - подключение через AF_UNIX
+ */
+void reactor_add_client(int new_socket, const struct sockaddr_storage* address, bool local) {
+    if (!quiet && local) {
+        printf("Новое подключение: сокет %d, локальный сокет\n", new_socket);
+    } else if (!quiet && address != NULL) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)address;
+        printf("Новое подключение: сокет %d, IP %s, порт %d\n",
+               new_socket, inet_ntoa(in->sin_addr), ntohs(in->sin_port));
+    } else if (!quiet) {
+        printf("Новое подключение: сокет %d, TCP\n", new_socket);
+    }
 
-    snprintf(msg, sizeof(msg), 
-        COLOR_RESET"Утилизация: %.2f%%\n"COLOR_RESET, utilization);
-    // printf("%s", msg);
-    send_to_client(client_sock, msg);
+    // Проверка лимита клиентов
+    Client* c = client_alloc();
+    if (c == NULL) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Сервер перегружен. Максимум %d клиентов.\n", max_clients);
+        send(new_socket, msg, strlen(msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+        close(new_socket);
+        reactor_syscalls += 2;
+        if (!quiet) {
+            printf("Отклонено подключение: достигнут лимит клиентов\n");
+        }
+        return;
+    }
+    c->fd = new_socket;
 
-    free(students);
-    free(tid);
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_recv_arm(c);
+    }
+#endif
+    if (epoll_fd >= 0) {
+        // EPOLLET: событие приходит один раз на каждое изменение состояния,
+        // поэтому читаем и пишем до EAGAIN
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+        reactor_syscalls++;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_socket, &ev) < 0) {
+            perror("epoll_ctl");
+            close(new_socket);
+            client_release(c);
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&clients_mutex);
+    c->listed = true;
+    num_clients++;
+    pthread_mutex_unlock(&clients_mutex);
+
+    // 1. Сигнал готовности
+    client_ready(c);
+}
+
+/**
+ * @brief Прием всех ожидающих подключений (edge-triggered)
+ * @param server_fd - слушающий сокет
+ *
+ * accept4(SOCK_NONBLOCK) принимает соединения пачкой до EAGAIN: сокет
+ * сразу неблокирующий, без отдельного fcntl на каждое подключение.
+ */
+void reactor_accept(int server_fd) {
+    while (1) {
+        struct sockaddr_storage address;
+        socklen_t addrlen = sizeof(address);
+
+        // accept4() принимает входящее соединение
+        // Возвращает новый неблокирующий сокет для общения с клиентом
+        int new_socket = accept4(server_fd, (struct sockaddr *)&address, &addrlen,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+        reactor_syscalls++;
+        if (new_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EWOULDBLOCK && errno != EAGAIN) {
+                // EMFILE/ENFILE: лимит дескрипторов, соединения остаются
+                // в очереди до следующего события
+                perror("accept failed");
+            }
+            return;
+        }
+
+        reactor_add_client(new_socket, &address, address.ss_family == AF_UNIX);
+    }
+}
+
+/**
+ * @brief Резидентная память процесса в КиБ (из /proc/self/statm)
+ */
+long rss_kib(void) {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief Поднятие лимита открытых дескрипторов до жесткого предела
+ */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/**
+ * @brief Название механизма ввода-вывода реактора
+ */
+const char* reactor_io_name(void) {
+    if (use_select) {
+        return "select";
+    }
+    return epoll_fd >= 0 ? "epoll" : "io_uring";
+}
+
+/**
+ * @brief Срок ожидания событий реактором, мс
+ * @param flush_deadline - момент отправки накопленного вывода (0 - нет)
+ *
+ * Пока вывод копится, ждем не дольше порога OUT_FLUSH_MS, иначе -
+ * секунду (вывод статуса).
+ */
+int reactor_timeout(long flush_deadline) {
+    if (flush_deadline == 0) {
+        return 1000;
+    }
+    long left = flush_deadline - now_ms();
+    return left > 0 ? (int)left : 0;
+}
+
+/**
+ * @brief Пробуждение от потоков симуляции (eventfd уже прочитан)
+ * @param flush_deadline - момент отправки накопленного вывода
+ */
+void reactor_on_wake(long* flush_deadline) {
+    if (__atomic_exchange_n(&flush_now, false, __ATOMIC_ACQ_REL)) {
+        reactor_drain_pending();
+        *flush_deadline = 0;
+    } else if (*flush_deadline == 0) {
+        *flush_deadline = now_ms() + OUT_FLUSH_MS;
+    }
+}
+
+/**
+ * @brief Вывод статуса сервера
+ * @param sec - секунд с прошлого вывода
+ */
+void reactor_status(time_t sec) {
+    pthread_mutex_lock(&jobs_mutex);
+    printf("Статус: активных клиентов: %d/%d, память %ld КиБ, слотов %d, "
+           "задания: очередь %d/%d, выполняется %d/%d, готово %lu, отклонено %lu\n",
+           num_clients, max_clients, rss_kib(), client_high,
+           job_depth, job_queue_limit, job_running, job_workers,
+           job_completed, job_rejected);
+    pthread_mutex_unlock(&jobs_mutex);
+
+    static unsigned long last_events = 0, last_calls = 0, last_cmds = 0;
+    unsigned long events_now = __atomic_load_n(&out_events, __ATOMIC_RELAXED);
+    unsigned long ev = events_now - last_events, calls = out_calls - last_calls;
+    if (ev > 0) {
+        printf("Вывод: %.0f событий/с, %.0f вызовов sendmsg/с, %.1f событий на вызов (%s)\n",
+               ev / (double)sec, calls / (double)sec,
+               calls ? (double)ev / calls : 0.0, unbuffered ? "без буферизации" : "с буферизацией");
+    }
+    pthread_mutex_lock(&bcast_mutex);
+    unsigned long lost = bcast_lost;
+    pthread_mutex_unlock(&bcast_mutex);
+    if (lost + bcast_dropped + slow_closed > 0) {
+        printf("Противодавление: рассылок потеряно %lu, не доставлено отстающим %lu, "
+               "медленных клиентов отключено %lu\n", lost, bcast_dropped, slow_closed);
+    }
+    pthread_mutex_lock(&cache_mutex);
+    if (cache_hits + cache_misses > 0) {
+        printf("Кэш: записей %lu, %zu/%zu КиБ, попаданий %lu, промахов %lu, вытеснено %lu\n",
+               cache_entries, cache_bytes / 1024, cache_budget / 1024,
+               cache_hits, cache_misses, cache_evicted);
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    // Итог с запуска: системные вызовы на одну команду клиента
+    if (reactor_cmds != last_cmds) {
+        printf("Реактор (%s): системных вызовов %lu, команд %lu, %.1f вызова на команду\n",
+               reactor_io_name(), reactor_syscalls, reactor_cmds,
+               reactor_cmds ? (double)reactor_syscalls / reactor_cmds : 0.0);
+    }
+    last_events = events_now;
+    last_calls = out_calls;
+    last_cmds = reactor_cmds;
+}
+
+/**
+ * @brief Конец итерации реактора: отправка вывода по сроку,
+ * освобождение закрытых клиентов и статус раз в 5 секунд
+ * @param flush_deadline - момент отправки накопленного вывода
+ */
+void reactor_tick_end(long* flush_deadline) {
+    if (*flush_deadline != 0 && now_ms() >= *flush_deadline) {
+        reactor_drain_pending();
+        *flush_deadline = 0;
+    }
+    reactor_free_clients();
+
+    static time_t last_status = 0;
+    time_t now = time(NULL);
+    if (now - last_status >= 5) {
+        reactor_status(now - last_status);
+        last_status = now;
+    }
 }
 
 // ============================================
-// ОБРАБОТКА КЛИЕНТА (В ОТДЕЛЬНОМ ПОТОКЕ)
+// РЕАКТОР НА SELECT (ключ -L)
 // ============================================
+// База для сравнения с epoll и io_uring: ядро не помнит набор
+// дескрипторов, поэтому он пересобирается обходом таблицы клиентов и
+// передается целиком на каждой итерации, а после select перебираются
+// все клиенты, а не только готовые. Наборы размечаются вручную:
+// клиентов может быть больше FD_SETSIZE (1024).
+
+static fd_mask* sel_rset = NULL;
+static fd_mask* sel_wset = NULL;
+static int sel_words = 0;
+
+static inline void fds_set(fd_mask* s, int fd) {
+    s[fd / NFDBITS] |= (fd_mask)1 << (fd % NFDBITS);
+}
+
+static inline bool fds_isset(const fd_mask* s, int fd) {
+    return s[fd / NFDBITS] & ((fd_mask)1 << (fd % NFDBITS));
+}
 
 /**
- * @brief Функция обработки клиента в отдельном потоке
- * @param arg - указатель на сокет клиента
- * 
- * Реализует протокол обмена:
- * 1. Отправляет сигнал готовности SERVER_READY
- * 2. Получает количество студентов через recv()
- * 3. Запускает симуляцию
- * 4. Закрывает соединение
+ * @brief Главный цикл реактора на select (не возвращается)
+ * @param server_fd - слушающий сокет TCP
+ * @param unix_fd - слушающий сокет AF_UNIX (-1 - нет)
+ *
+ * Чтение и запись те же, что у epoll: до EAGAIN. Запись ждем только у
+ * клиентов с неотправленной цепочкой - иначе select не спал бы совсем.
  */
-void* handle_client(void* arg) {
-    int client_sock = *(int*)arg;
-    free(arg);
+void select_reactor(int server_fd, int unix_fd) {
+    long flush_deadline = 0;
+    while (1) {
+        int maxfd = server_fd > wake_fd ? server_fd : wake_fd;
+        if (unix_fd > maxfd) {
+            maxfd = unix_fd;
+        }
+        for (int i = 0; i < client_high; i++) {
+            Client* c = client_at(i);
+            if (c->listed && c->fd > maxfd) {
+                maxfd = c->fd;
+            }
+        }
+        int words = maxfd / NFDBITS + 1;
+        if (words > sel_words) {
+            sel_words = words * 2;
+            sel_rset = realloc(sel_rset, sel_words * sizeof(fd_mask));
+            sel_wset = realloc(sel_wset, sel_words * sizeof(fd_mask));
+        }
+        memset(sel_rset, 0, words * sizeof(fd_mask));
+        memset(sel_wset, 0, words * sizeof(fd_mask));
 
-    char buffer[BUFFER_SIZE];
-    char response[BUFFER_SIZE];
+        fds_set(sel_rset, server_fd);
+        if (unix_fd >= 0) {
+            fds_set(sel_rset, unix_fd);
+        }
+        fds_set(sel_rset, wake_fd);
+        // listed меняет только реактор: читаем без clients_mutex
+        for (int i = 0; i < client_high; i++) {
+            Client* c = client_at(i);
+            if (!c->listed) {
+                continue;
+            }
+            fds_set(sel_rset, c->fd);
+            if (c->send_head != NULL) {
+                fds_set(sel_wset, c->fd);
+            }
+        }
 
-    while (1) {
+        int ms = reactor_timeout(flush_deadline);
+        struct timeval tv = { .tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000 };
+        int n = select(maxfd + 1, (fd_set*)sel_rset, (fd_set*)sel_wset, NULL, &tv);
+        reactor_syscalls++;
+        if (n < 0 && errno != EINTR) {
+            perror("select");
+        }
 
-        // 1. Сигнал готовности
-        snprintf(response, sizeof(response),
-                 "SERVER_READY: Отправьте количество студентов или quit\n");
-        send(client_sock, response, strlen(response), 0);
+        if (n > 0) {
+            if (fds_isset(sel_rset, server_fd)) {
+                reactor_accept(server_fd);
+            }
+            if (unix_fd >= 0 && fds_isset(sel_rset, unix_fd)) {
+                reactor_accept(unix_fd);
+            }
+            if (fds_isset(sel_rset, wake_fd)) {
+                uint64_t cnt;
+                if (read(wake_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) {
+                    perror("eventfd read");
+                }
+                reactor_syscalls++;
+                reactor_on_wake(&flush_deadline);
+            }
+            // Клиенты, принятые в этой итерации, в наборах не отмечены,
+            // но их дескриптор может оказаться за пределами наборов
+            for (int i = 0; i < client_high; i++) {
+                Client* c = client_at(i);
+                if (!c->listed || c->fd > maxfd) {
+                    continue;
+                }
+                if (fds_isset(sel_rset, c->fd)) {
+                    client_on_readable(c);
+                }
+                if (!c->dead && fds_isset(sel_wset, c->fd)) {
+                    client_flush(c);
+                }
+            }
+        }
+        reactor_tick_end(&flush_deadline);
+    }
+}
+
+#ifdef USE_IO_URING
+// ============================================
+// РЕАКТОР НА IO_URING
+// ============================================
+// Тот же однопоточный реактор, но ввод-вывод идет через кольцо (uring.h):
+// multishot accept на слушающих сокетах, multishot recv в кольцо буферов
+// на каждого клиента и по SEND на каждый блок вывода. SEND одной
+// отправки связаны IOSQE_IO_LINK и выполняются по порядку; MSG_WAITALL
+// делает недосылку ошибкой, которая отменяет остаток цепочки. Все SQE
+// итерации уходят ядру тем же io_uring_enter, которым реактор ждет
+// событий, поэтому на команду не остается отдельных recv/sendmsg.
+//
+// Каждый запрос в кольце держит ссылку на клиента (refs): структура
+// освобождается, когда завершится последний из них.
+
+// Вид запроса - в младших битах user_data, выше - клиент или дескриптор
+enum { UD_RECV, UD_SEND, UD_ACCEPT, UD_WAKE, UD_CANCEL };
+#define UD_KIND_MASK 7ull
+
+uring_t ring;
+uring_bufs_t ring_bufs;         // Буферы multishot recv
+uint64_t ring_wake_val;         // Приемник чтения wake_fd
+int ring_unix_fd = -1;          // Слушающий AF_UNIX (для сообщения о подключении)
+
+static inline uint64_t ud_client(Client* c, int kind) {
+    return (uint64_t)(uintptr_t)c | kind;
+}
 
-        // 2. Получение команды
-        memset(buffer, 0, BUFFER_SIZE);
-        int recv_len = recv(client_sock, buffer, BUFFER_SIZE - 1, 0);
+void uring_accept_arm(int fd) {
+    uring_prep_accept_multishot(uring_sqe(&ring), fd, (uint64_t)fd << 3 | UD_ACCEPT);
+}
 
-        if (recv_len <= 0)
-            break;
+void uring_wake_arm(void) {
+    uring_prep_read(uring_sqe(&ring), wake_fd, &ring_wake_val, sizeof(ring_wake_val), UD_WAKE);
+}
 
-        buffer[recv_len] = '\0';
+/**
+ * @brief Взвод multishot recv клиента
+ * @param c - клиент
+ */
+void uring_recv_arm(Client* c) {
+    uring_prep_recv_multishot(uring_sqe(&ring), c->fd, ring_bufs.bgid, ud_client(c, UD_RECV));
+    c->recv_armed = true;
+    c->refs++;
+}
 
-        // 3. Проверка на quit
-        if (strncmp(buffer, "quit", 4) == 0 ||
-            strncmp(buffer, "exit", 4) == 0) {
-            send(client_sock, "Отключение...\n", 15, 0);
-            break;
+/**
+ * @brief Отправка цепочки блоков связанными SEND
+ * @param c - клиент
+ *
+ * Пока предыдущая цепочка в кольце, новая не ставится: ее продолжит
+ * завершение последнего SEND.
+ */
+void uring_client_send(Client* c) {
+    if (c->sends > 0) {
+        return;
+    }
+    if (c->send_head == NULL) {
+        if (c->state == CONN_CLOSING) {
+            client_close(c);
         }
+        return;
+    }
 
-        int studLen = atoi(buffer);
+    if (uring_sq_space(&ring) < OUT_IOV_MAX) {
+        uring_enter(&ring, 0);
+        reactor_syscalls++;
+    }
+    struct io_uring_sqe* prev = NULL;
+    for (OutBlock* blk = c->send_head; blk != NULL && c->sends < OUT_IOV_MAX; blk = blk->next) {
+        struct io_uring_sqe* sqe = uring_sqe(&ring);
+        uring_prep_send(sqe, c->fd, blk->data + blk->off, blk->len - blk->off, ud_client(c, UD_SEND));
+        sqe->msg_flags |= MSG_WAITALL;
+        if (prev != NULL) {
+            prev->flags |= IOSQE_IO_LINK;
+        }
+        prev = sqe;
+        c->sends++;
+        c->refs++;
+    }
+    out_calls++;    // одна отправка цепочки вместо вызова sendmsg
+}
 
-        if (studLen > 0 && studLen <= 100) {
-            snprintf(response, sizeof(response),
-                     "Принято: %d студентов. Запуск...\n", studLen);
-            send(client_sock, response, strlen(response), 0);
+/**
+ * @brief Завершение SEND: блок в голове цепочки отправлен
+ * @param c - клиент
+ * @param res - отправлено байт или -errno
+ */
+void uring_on_send(Client* c, int res) {
+    OutBlock* blk = c->send_head;
+    c->sends--;
+    c->refs--;
+
+    size_t sent = res > 0 ? (size_t)res : 0;
+    if (sent < blk->len - blk->off) {
+        c->send_failed = true;  // остаток цепочки ядро отменит
+    }
+    c->send_head = blk->next;
+    if (c->send_head == NULL) {
+        c->send_tail = NULL;
+    }
+    free(blk);
+    if (sent > 0) {
+        out_sent += sent;
+        pthread_mutex_lock(&c->out_mutex);
+        c->backlog -= sent;
+        pthread_mutex_unlock(&c->out_mutex);
+    }
+
+    if (c->sends > 0) {
+        return;
+    }
+    if (c->dead) {
+        out_free_chain(c->send_head);
+        c->send_head = c->send_tail = NULL;
+        client_maybe_free(c);
+    } else if (c->send_failed) {
+        client_close(c);
+    } else {
+        client_flush(c);
+    }
+}
 
-            run_simulation(studLen, client_sock);
+/**
+ * @brief Данные из буфера recv во входной буфер клиента
+ * @param c - клиент
+ * @param data - данные
+ * @param len - длина
+ */
+void uring_client_input(Client* c, const char* data, size_t len) {
+    while (len > 0 && client_in_room(c)) {
+        size_t n = sizeof(c->in) - 1 - c->in_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(c->in + c->in_len, data, n);
+        c->in_len += n;
+        data += n;
+        len -= n;
+    }
+    client_process_input(c);
+}
 
-            send(client_sock,
-                 "Симуляция завершена.\n",
-                 22, 0);
+/**
+ * @brief Завершение multishot recv
+ * @param c - клиент
+ * @param res - принято байт, 0 - клиент закрыл соединение, или -errno
+ * @param flags - флаги CQE (номер буфера, IORING_CQE_F_MORE)
+ */
+void uring_on_recv(Client* c, int res, unsigned flags) {
+    if (res > 0) {
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (!c->dead) {
+            uring_client_input(c, uring_bufs_at(&ring_bufs, bid), res);
+        }
+        uring_bufs_put(&ring_bufs, bid);
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // recv снят: конец данных, ошибка, отмена или кончились буферы
+        c->recv_armed = false;
+        if (res == -ENOBUFS) {
+            // Возвращенные в этой итерации буферы ядро еще не видит: без
+            // публикации новый recv снова сразу получил бы ENOBUFS
+            uring_bufs_publish(&ring_bufs);
+        }
+        if (!c->dead && (res > 0 || res == -ENOBUFS)) {
+            uring_recv_arm(c);
         } else {
-            send(client_sock,
-                 "Ошибка: 1-100\n",
-                 14, 0);
+            client_close(c);
         }
+        c->refs--;
+        client_maybe_free(c);
     }
+}
 
-    close(client_sock);
-    return NULL;
+/**
+ * @brief Завершение multishot accept
+ * @param fd - слушающий сокет
+ * @param res - сокет клиента или -errno
+ * @param flags - флаги CQE
+ */
+void uring_on_accept(int fd, int res, unsigned flags) {
+    if (res >= 0) {
+        reactor_add_client(res, NULL, fd == ring_unix_fd);
+    } else if (res != -EAGAIN && res != -ECONNABORTED) {
+        errno = -res;
+        perror("accept failed");
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        uring_accept_arm(fd);
+    }
+}
+
+/**
+ * @brief Снятие запросов закрываемого клиента
+ * @param c - клиент
+ *
+ * Запросы держат сокет открытым и после close(), поэтому отменяются:
+ * recv и все SEND (по user_data, без дескриптора).
+ */
+void uring_client_close(Client* c) {
+    if (c->recv_armed) {
+        uring_prep_cancel(uring_sqe(&ring), ud_client(c, UD_RECV), UD_CANCEL);
+    }
+    if (c->sends > 0) {
+        uring_prep_cancel_all(uring_sqe(&ring), ud_client(c, UD_SEND), UD_CANCEL);
+    }
+}
+
+/**
+ * @brief Запуск реактора на io_uring
+ * @param server_fd - слушающий TCP-сокет
+ * @param unix_fd - слушающий AF_UNIX (-1 - нет)
+ * @return false - ядро не дает кольцо или кольцо буферов (старше 6.0,
+ *         io_uring_disabled): реактор работает на epoll
+ */
+bool uring_start(int server_fd, int unix_fd) {
+    int err = uring_init(&ring, URING_ENTRIES);
+    if (err == 0) {
+        err = uring_bufs_init(&ring, &ring_bufs, 0, URING_BUFS, URING_BUF_SIZE);
+    }
+    if (err < 0) {
+        fprintf(stderr, "io_uring недоступен (%s), реактор на epoll\n", strerror(-err));
+        uring_bufs_free(&ring_bufs);
+        uring_exit(&ring);
+        return false;
+    }
+
+    // Чтение кольцом ждет данных само: с O_NONBLOCK оно завершилось бы
+    // с EAGAIN. Запись в eventfd не блокируется и так
+    fcntl(wake_fd, F_SETFL, fcntl(wake_fd, F_GETFL) & ~O_NONBLOCK);
+    uring_wake_arm();
+    uring_accept_arm(server_fd);
+    if (unix_fd >= 0) {
+        uring_accept_arm(unix_fd);
+    }
+    ring_unix_fd = unix_fd;
+    use_uring = true;
+    return true;
+}
+
+/**
+ * @brief Главный цикл реактора на io_uring (не возвращается)
+ */
+void uring_reactor(void) {
+    long flush_deadline = 0;
+    while (1) {
+        // Отправка SQE итерации и ожидание событий - один системный вызов
+        int ret = uring_enter_timeout(&ring, 1, reactor_timeout(flush_deadline));
+        reactor_syscalls++;
+        if (ret < 0 && ret != -ETIME && ret != -EBUSY) {
+            errno = -ret;
+            perror("io_uring_enter");
+        }
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring_cqe_peek(&ring)) != NULL) {
+            uint64_t ud = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring_cqe_seen(&ring);
+
+            switch (ud & UD_KIND_MASK) {
+            case UD_RECV:
+                uring_on_recv((Client*)(uintptr_t)(ud & ~UD_KIND_MASK), res, flags);
+                break;
+            case UD_SEND:
+                uring_on_send((Client*)(uintptr_t)(ud & ~UD_KIND_MASK), res);
+                break;
+            case UD_ACCEPT:
+                uring_on_accept((int)(ud >> 3), res, flags);
+                break;
+            case UD_WAKE:
+                uring_wake_arm();
+                reactor_on_wake(&flush_deadline);
+                break;
+            default:
+                break;
+            }
+        }
+        uring_bufs_publish(&ring_bufs);
+        reactor_tick_end(&flush_deadline);
+    }
 }
+#endif
 
 // ============================================
 // ГЛАВНАЯ ФУНКЦИЯ СЕРВЕРА
 // ============================================
 
+/**
+ * @brief Слушающий сокет AF_UNIX для клиентов на этой же машине
+ * @param path - путь сокета в файловой системе
+ * @return неблокирующий слушающий сокет, -1 при ошибке
+ *
+ * Протокол тот же, что по TCP, но без сетевого стека: нет контрольных
+ * сумм, подтверждений и петлевого интерфейса.
+ */
+int unix_listen(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Слишком длинный путь сокета: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket AF_UNIX");
+        return -1;
+    }
+    unlink(path);   // Файл от прошлого запуска мешает bind
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("bind/listen AF_UNIX");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
 /**
  * @brief Главная функция сервера
- * 
+ *
  * Алгоритм работы:
  * 1. Создание TCP-сокета (socket)
  * 2. Настройка опций (setsockopt)
  * 3. Привязка к адресу и порту (bind)
  * 4. Перевод в режим прослушивания (listen)
  * 5. Установка неблокирующего режима (fcntl)
- * 6. Цикл обработки подключений с использованием select()
- * 7. Создание потока для каждого клиента
+ * 6. Реактор на epoll (edge-triggered): прием подключений, чтение команд
+ *    и отправка всего вывода выполняются в одном потоке. В сборке с
+ *    USE_IO_URING тот же реактор работает через кольцо io_uring, а при
+ *    отказе ядра - на epoll. С -L - на select (база для сравнения)
+ * 7. Симуляции ставятся в ограниченную очередь и выполняются пулом
+ *    рабочих потоков, которые пишут в буферы клиентов
+ *
+ * Ключи: -c <макс. клиентов>, -q (без вывода каждого подключения),
+ * -s (все симуляции в общем общежитии, как "dorm N"),
+ * -B (нулевое время в душе для замера пропускной способности),
+ * -u (без буферизации вывода: каждое событие отправляется сразу),
+ * -w <рабочих потоков>, -Q <глубина очереди заданий>,
+ * -S <предел студентов в одном запросе>,
+ * -M <бюджет кэша результатов, МиБ; 0 - без кэша>, -P <файл кэша>,
+ * -U <путь локального сокета; "" - только TCP>,
+ * -L (реактор на select вместо epoll и io_uring)
  */
-int main() {
+int main(int argc, char* argv[]) {
     srand((unsigned)time(NULL));
-    
-    int server_fd, new_socket;
+
+    const char* cache_path = NULL;
+    const char* unix_path = UNIX_PATH;
+    int opt_c;
+    while ((opt_c = getopt(argc, argv, "c:qsBuw:Q:S:M:P:U:L")) != -1) {
+        switch (opt_c) {
+        case 'c':
+            max_clients = atoi(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 's':
+            dorm_default = true;
+            break;
+        case 'B':
+            bench_mode = true;
+            break;
+        case 'u':
+            unbuffered = true;
+            break;
+        case 'w':
+            job_workers = atoi(optarg);
+            break;
+        case 'Q':
+            job_queue_limit = atoi(optarg);
+            break;
+        case 'S':
+            sim_max_students = atoi(optarg);
+            break;
+        case 'M':
+            cache_budget = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'P':
+            cache_path = optarg;
+            break;
+        case 'U':
+            unix_path = optarg;
+            break;
+        case 'L':
+            use_select = true;
+            break;
+        default:
+            fprintf(stderr, "Использование: %s [-c макс_клиентов] [-q] [-s] "
+                            "[-B] [-u] [-w рабочих] [-Q очередь] [-S макс_студентов] "
+                            "[-M кэш_МиБ] [-P файл_кэша] [-U локальный_сокет] [-L]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (max_clients <= 0) {
+        max_clients = MAX_CLIENTS;
+    }
+    if (job_workers <= 0) {
+        job_workers = SIM_WORKERS;
+    }
+    // Номер задания должен оставаться доступным, пока оно не завершено
+    if (job_queue_limit <= 0 || job_queue_limit + job_workers > JOB_HISTORY / 2) {
+        job_queue_limit = JOB_QUEUE_DEPTH;
+    }
+    // Номер студента и их число передаются в кадрах 16-битными полями
+    if (sim_max_students <= 0 || sim_max_students > UINT16_MAX) {
+        sim_max_students = SIM_MAX_STUDENTS;
+    }
+    if (cache_path != NULL && cache_budget > 0) {
+        cache_open(cache_path);
+    }
+
+    raise_fd_limit();
+
+    int server_fd;
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
-    fd_set readfds;  // Набор дескрипторов для select()
-    
-    // Инициализация массива клиентских сокетов
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        client_sockets[i] = 0;
-    }
-    
+
     // ============================================
     // ШАГ 1: Создание TCP-сокета
     // ============================================
@@ -499,11 +3322,11 @@ int main() {
     // AF_INET - IPv4 интернет-протокол
     // SOCK_STREAM - потоковый сокет (TCP)
     // 0 - протокол по умолчанию для данного типа
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         perror("socket failed");
         exit(EXIT_FAILURE);
     }
-    
+
     // ============================================
     // ШАГ 2: Настройка опций сокета
     // ============================================
@@ -513,14 +3336,14 @@ int main() {
         perror("setsockopt failed");
         exit(EXIT_FAILURE);
     }
-    
+
     // ============================================
     // ШАГ 3: Настройка адреса сервера
     // ============================================
     address.sin_family = AF_INET;           // Семейство адресов IPv4
     address.sin_addr.s_addr = /*inet_addr("10.111.255.122") */INADDR_ANY; // Принимать соединения на всех интерфейсах
     address.sin_port = htons(PORT);       // Порт (htons - перевод в сетевой порядок байт)
-    
+
     // ============================================
     // ШАГ 4: Привязка сокета к адресу
     // ============================================
@@ -528,17 +3351,18 @@ int main() {
         perror("bind failed");
         exit(EXIT_FAILURE);
     }
-    
+
     // ============================================
     // ШАГ 5: Перевод в режим прослушивания
     // ============================================
     // listen(sockfd, backlog)
     // backlog - максимальная длина очереди ожидающих соединений
-    if (listen(server_fd, 3) < 0) {
+    // (ядро ограничивает ее значением net.core.somaxconn)
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen failed");
         exit(EXIT_FAILURE);
     }
-    
+
     // ============================================
     // ШАГ 6: Установка неблокирующего режима
     // ============================================
@@ -547,129 +3371,136 @@ int main() {
     // O_NONBLOCK - неблокирующий режим
     int flags = fcntl(server_fd, F_GETFL, 0);
     fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
-    
+
+    // ============================================
+    // ШАГ 7: Создание eventfd для пробуждения и epoll (или кольца io_uring)
+    // ============================================
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    // Локальные клиенты подключаются через AF_UNIX в обход TCP
+    int unix_fd = unix_path[0] ? unix_listen(unix_path) : -1;
+
+#ifdef USE_IO_URING
+    // Сборка с USE_IO_URING: прием, чтение и запись через кольцо
+    bool on_ring = !use_select && uring_start(server_fd, unix_fd);
+#else
+    bool on_ring = false;
+#endif
+    if (!on_ring && !use_select) {
+        epoll_fd = epoll_create1(0);
+        if (epoll_fd < 0) {
+            perror("epoll_create1");
+            exit(EXIT_FAILURE);
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &listen_tag;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+
+        if (unix_fd >= 0) {
+            ev.events = EPOLLIN | EPOLLET;
+            ev.data.ptr = &unix_tag;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, unix_fd, &ev);
+        }
+
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &wake_tag;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    }
+
+    for (int i = 0; i < job_workers; i++) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, sim_worker, NULL) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(worker);
+    }
+
     printf("Сервер запущен на порту %d\n", PORT);
-    printf("Ожидание подключений (макс. %d клиентов)...\n", MAX_CLIENTS);
-    
+    if (unix_fd >= 0) {
+        printf("Локальный сокет: %s\n", unix_path);
+    }
+    printf("Пул симуляций: %d потоков, очередь до %d заданий\n", job_workers, job_queue_limit);
+    printf("Ввод-вывод: %s\n", reactor_io_name());
+    printf("Ожидание подключений (макс. %d клиентов)...\n", max_clients);
+
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_reactor();
+    }
+#endif
+    if (use_select) {
+        select_reactor(server_fd, unix_fd);
+    }
+
     // ============================================
-    // ГЛАВНЫЙ ЦИКЛ ОБРАБОТКИ ПОДКЛЮЧЕНИЙ
+    // ГЛАВНЫЙ ЦИКЛ РЕАКТОРА
     // ============================================
+    struct epoll_event events[MAX_EVENTS];
+    long flush_deadline = 0;    // Момент отправки накопленного вывода, мс (0 - нет)
     while (1) {
-        // Очистка набора дескрипторов
-        FD_ZERO(&readfds);
-        // Добавление серверного сокета в набор
-        FD_SET(server_fd, &readfds);
-        int max_sd = server_fd;
-        
-        // Добавление клиентских сокетов в набор для select()
-        pthread_mutex_lock(&clients_mutex);
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (client_sockets[i] > 0) {
-                FD_SET(client_sockets[i], &readfds);
-                if (client_sockets[i] > max_sd) {
-                    max_sd = client_sockets[i];
-                }
-            }
+        // epoll_wait возвращает только готовые дескрипторы:
+        // нет пересборки набора и перебора всех клиентов
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, reactor_timeout(flush_deadline));
+        reactor_syscalls++;
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
         }
-        pthread_mutex_unlock(&clients_mutex);
-        
-        // ============================================
-        // ВЫЗОВ SELECT() - МУЛЬТИПЛЕКСИРОВАНИЕ ВВОДА/ВЫВОДА
-        // ============================================
-        // select(nfds, readfds, writefds, exceptfds, timeout)
-        // nfds - максимальный дескриптор + 1
-        // readfds - набор дескрипторов для чтения
-        // timeout - таймаут (NULL - блокирующий, {0,0} - неблокирующий)
-        struct timeval tv;
-        tv.tv_sec = 1;   // Таймаут 1 секунда (неблокирующий режим)
-        tv.tv_usec = 0;
-        
-        int activity = select(max_sd + 1, &readfds, NULL, NULL, &tv);
-        
-        if (activity < 0 && errno != EINTR) {
-            perror("select error");
-        }
-        
-        // ============================================
-        // ПРОВЕРКА НОВЫХ ПОДКЛЮЧЕНИЙ
-        // ============================================
-        if (FD_ISSET(server_fd, &readfds)) {
-            // accept() принимает входящее соединение
-            // Возвращает новый сокет для общения с клиентом
-            if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-                if (errno != EWOULDBLOCK && errno != EAGAIN) {
-                    perror("accept failed");
+
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+
+            if (tag == &listen_tag) {
+                reactor_accept(server_fd);
+            } else if (tag == &unix_tag) {
+                reactor_accept(unix_fd);
+            } else if (tag == &wake_tag) {
+                uint64_t cnt;
+                if (read(wake_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) {
+                    perror("eventfd read");
                 }
+                reactor_syscalls++;
+                reactor_on_wake(&flush_deadline);
             } else {
-                printf("Новое подключение: сокет %d, IP %s, порт %d\n",
-                       new_socket, inet_ntoa(address.sin_addr), ntohs(address.sin_port));
-                
-                pthread_mutex_lock(&clients_mutex);
-                // Проверка лимита клиентов
-                if (num_clients >= MAX_CLIENTS) {
-                    char msg[] = "Сервер перегружен. Максимум 3 клиента.\n";
-                    send(new_socket, msg, strlen(msg), 0);
-                    close(new_socket);
-                    printf("Отклонено подключение: достигнут лимит клиентов\n");
-                } else {
-                    // Добавление в массив клиентов
-                    for (int i = 0; i < MAX_CLIENTS; i++) {
-                        if (client_sockets[i] == 0) {
-                            client_sockets[i] = new_socket;
-                            num_clients++;
-                            break;
-                        }
-                    }
-                    
-                    // Создание потока для обработки клиента
-                    int* sock_ptr = malloc(sizeof(int));
-                    *sock_ptr = new_socket;
-                    pthread_t thread_id;
-                    pthread_create(&thread_id, NULL, handle_client, sock_ptr);
-                    pthread_detach(thread_id);  // Отсоединяем поток (автоочистка)
+                Client* c = (Client*)tag;
+                // Клиент мог быть закрыт раньше в этой же итерации
+                // (структура жива до reactor_free_clients)
+                if (c->dead) {
+                    continue;
                 }
-                pthread_mutex_unlock(&clients_mutex);
-            }
-        }
-        
-        // ============================================
-        // ПРОВЕРКА ОТКЛЮЧЕНИЙ КЛИЕНТОВ
-        // ============================================
-        pthread_mutex_lock(&clients_mutex);
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (client_sockets[i] > 0 && FD_ISSET(client_sockets[i], &readfds)) {
-                char buffer[BUFFER_SIZE];
-                // MSG_PEEK - просмотр данных без удаления из буфера
-                int valread = recv(client_sockets[i], buffer, BUFFER_SIZE, MSG_PEEK);
-                if (valread == 0) {
-                    // Клиент закрыл соединение
-                    close(client_sockets[i]);
-                    client_sockets[i] = 0;
-                    num_clients--;
-                    printf("Клиент отключился. Активных: %d\n", num_clients);
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    client_on_readable(c);
+                }
+                if (!c->dead && (events[i].events & EPOLLOUT)) {
+                    client_flush(c);
                 }
             }
         }
-        pthread_mutex_unlock(&clients_mutex);
-        
-        // ============================================
-        // ВЫВОД СТАТУСА (неблокирующий режим)
-        // ============================================
-        static time_t last_status = 0;
-        time_t now = time(NULL);
-        if (now - last_status >= 5) {
-            printf("Статус: ожидание подключений... (активных клиентов: %d/%d)\n", 
-                   num_clients, MAX_CLIENTS);
-            last_status = now;
-        }
+        reactor_tick_end(&flush_deadline);
     }
-    
+
     // Очистка ресурсов (теоретически недостижимый код в данном цикле)
     close(server_fd);
-    pthread_mutex_destroy(&b.dataMutex);
-    pthread_mutex_destroy(&b.condMutex);
-    pthread_cond_destroy(&b.cond);
+    close(epoll_fd);
+    close(wake_fd);
+    pthread_mutex_destroy(&dorm.dataMutex);
+    pthread_mutex_destroy(&dorm.condMutex);
+    pthread_cond_destroy(&dorm.cond);
+    while (bath_free_head != NULL) {
+        Br* br = bath_free_head;
+        bath_free_head = br->next_free;
+        pthread_mutex_destroy(&br->dataMutex);
+        pthread_mutex_destroy(&br->condMutex);
+        pthread_cond_destroy(&br->cond);
+        free(br);
+    }
     pthread_mutex_destroy(&clients_mutex);
-    
+
     return 0;
 }
@@ -5,14 +5,36 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <time.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <poll.h>
+
+#include "wire.h"
+#ifdef USE_IO_URING
+#include "uring.h"
+#endif
 
 #define PORT 8989
-#define BACKLOG 10
+#define UNIX_PATH "/tmp/lab4_server_.sock" // локальный сокет (ключ -u, "" - без него)
+#define BACKLOG 128
 #define CAPACITY 3
 #define STREAK_LIMIT 5
+#define LOOP_THREADS 1      // потоков цикла событий по умолчанию (ключ -t)
+#define MAX_EVENTS 256
+#define LEASE_SEC 0         // аренда места по умолчанию, 0 - без срока (ключ -l)
+#define URING_ENTRIES 1024  // очередь отправки кольца io_uring цикла
+#define URING_BUFS 1024     // буферов recv в кольце буферов цикла
+#define URING_BUF_SIZE 2048
 
 #define COLOR_YELLOW "\033[33m"
 #define COLOR_GREEN "\033[32m"
@@ -22,9 +44,84 @@
 typedef enum { MALE = 0, FEMALE = 1 } gender_t;
 typedef enum { EMPTY, MEN_INSIDE, WOMEN_INSIDE } bath_state_t;
 
+// Формат сообщений соединения: определяется по первому байту
+typedef enum {
+    FMT_UNKNOWN,
+    FMT_WIRE,               // компактные кадры wire.h
+    FMT_RAW,                // прежний сырой msg_t
+} conn_format_t;
+
+// Соединение клиента. По одному соединению может идти JOIN/LEAVE
+// любого числа студентов: ответ на JOIN приходит с id студента.
+// Соединение принадлежит одному циклу событий и в сокет пишет только
+// он; ответы же в буфер дописывает любой цикл (разрешение уходит тому,
+// кто ждал), поэтому исходящий буфер защищен tx_mutex
+typedef struct conn {
+    int fd;
+    int epfd;               // epoll цикла-владельца
+    conn_format_t format;
+    uint8_t rx[WIRE_MAX_FRAME]; // недоразобранные байты
+    size_t rx_len;
+
+    pthread_mutex_t tx_mutex;
+    char *tx;               // не ушедшие в сокет байты
+    size_t tx_len, tx_cap;
+    bool want_out;          // ждем EPOLLOUT
+
+    bool dirty;             // есть ответы этого захвата (под bath_s.mutex)
+    struct conn *dirty_next;
+    bool closing;           // закрывается в конце такта цикла-владельца
+    struct conn *close_next;
+
+    struct loop *loop;      // цикл-владелец
+    struct conn *kick_next; // в списке пинков владельца
+    bool flush_queued;      // в списке досылки владельца (под его kick_mutex)
+    struct conn *flush_next;
+    int sel_index;          // место в массиве соединений цикла (select)
+
+#ifdef USE_IO_URING
+    // Отправка через кольцо владельца: SEND в полете держит tx_out,
+    // новые ответы копятся в tx. Поля tx_out* - под tx_mutex
+    char *tx_out;
+    size_t tx_out_len, tx_out_off, tx_out_cap;
+    int ops;                // запросов в кольце и пинок нового соединения (атомарно)
+    bool recv_armed;        // взведен multishot recv
+    bool destroyed;         // освобождается, когда ops дойдет до 0
+#endif
+} conn_t;
+
+// Студент, ожидающий входа: узел очереди своего пола. Ожидание не
+// занимает ни потока, ни соединения; разрешение (MSG_UPDATE с его id)
+// отправляет тот цикл, при котором освободилось место
+typedef struct waiter {
+    int id;
+    int gender;
+    long wait_start;        // часы клиента: только возвращается в ответе
+    uint64_t join_ns;       // прием JOIN по часам сервера
+    uint64_t service_ns;    // выход отмеряет сервер, 0 - ждем LEAVE
+    unsigned long seq;      // порядок JOIN между очередями
+    conn_t *conn;
+    struct waiter *next;
+} waiter_t;
+
+typedef struct {
+    waiter_t *head;
+    waiter_t *tail;
+} wait_queue_t;
+
+// Занятое место: кто вошел и когда (conn == NULL - место свободно).
+// Место освобождается по LEAVE этого студента с этого соединения,
+// по таймеру выхода, при закрытии соединения или по истечении аренды
+typedef struct {
+    conn_t *conn;
+    int id;
+    int gender;
+    uint64_t grant_ns;
+    uint64_t depart_ns;     // выход по таймеру сервера, 0 - по LEAVE
+} slot_t;
+
 typedef struct {
     pthread_mutex_t mutex;
-    pthread_cond_t cond;
 
     int capacity;
     int occupied;
@@ -37,17 +134,22 @@ typedef struct {
     int remaining_male;
     int remaining_female;
 
-    long total_wait_time;
-    long total_bath_time;
-    int entered_count;
-    int male_entered, female_entered;
+    slot_t slots[CAPACITY];
+    uint64_t lease_ns;      // 0 - аренда без срока
+    int timer_fd;           // timerfd ближайшего выхода или истечения аренды
+    uint64_t timer_at;      // ближайший срок, 0 - нет (под mutex)
+    pthread_mutex_t timer_mutex;
+    uint64_t timer_set;     // на когда взведен timerfd (под timer_mutex)
+
+    wait_queue_t wait_q[2]; // ожидающие по полу: [MALE], [FEMALE]
+    unsigned long join_seq;
+    conn_t *dirty;          // соединения с неотправленными ответами
 } bath_server_t;
 
 bath_server_t bath_s;
 
 void bath_server_init(bath_server_t *b) {
     pthread_mutex_init(&b->mutex, NULL);
-    pthread_cond_init(&b->cond, NULL);
     b->capacity = CAPACITY;
     b->occupied = 0;
     b->bath_gender = EMPTY;
@@ -56,159 +158,1379 @@ void bath_server_init(bath_server_t *b) {
     b->streak_limit = STREAK_LIMIT;
     b->remaining_male = 0;
     b->remaining_female = 0;
-    b->total_wait_time = 0;
-    b->total_bath_time = 0;
-    b->entered_count = 0;
-    b->male_entered = 0;
-    b->female_entered = 0;
+    memset(b->slots, 0, sizeof(b->slots));
+    b->lease_ns = (uint64_t)LEASE_SEC * 1000000000ull;
+    b->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    b->timer_at = 0;
+    pthread_mutex_init(&b->timer_mutex, NULL);
+    b->timer_set = 0;
+    memset(b->wait_q, 0, sizeof(b->wait_q));
+    b->join_seq = 0;
+    b->dirty = NULL;
 }
 
-// Структура сообщений
-typedef enum {
-    MSG_JOIN,
-    MSG_LEAVE,
-    MSG_UPDATE,
-    MSG_STATS
-} msg_type_t;
+_Static_assert(WIRE_RAW_SIZE <= WIRE_MAX_FRAME, "conn_t.rx меньше msg_t");
+
+uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+// ============================================
+// СТАТИСТИКА
+// ============================================
+// Счетчики разнесены по потокам циклов событий: каждый поток пишет
+// только в свою долю (своя кэш-линия), чтение MSG_STATS не берет
+// bath_s.mutex. Долю читатель копирует под seqlock: счетчик seq
+// нечетный, пока владелец меняет долю; если seq изменился за время
+// копирования, копия повторяется. Писатель читателя не ждет.
+//
+// syscalls - системные вызовы циклов на пути сообщений (ожидание,
+// прием, отправка, таймер) для сравнения epoll и io_uring; установка
+// и закрытие соединений не считаются.
+
+typedef struct {
+    unsigned seq;
+    // Времена по часам сервера (CLOCK_MONOTONIC), индекс - пол
+    long wait_ns[2];
+    long bath_ns[2];
+    uint32_t wait_hist[2][WIRE_LAT_BUCKETS];
+    uint32_t bath_hist[2][WIRE_LAT_BUCKETS];
+    int entered[2];
+    int reclaimed_disconnect;
+    int reclaimed_lease;
+    long lock_acquisitions; // захватов bath_s.mutex этим потоком
+    long grants;
+    long syscalls;
+} __attribute__((aligned(64))) stats_shard_t;
+
+stats_shard_t *stats_shards;
+int stats_shard_count;
+__thread stats_shard_t *my_stats;   // доля текущего потока цикла
+
+void stats_init(int shards) {
+    stats_shard_count = shards;
+    stats_shards = aligned_alloc(64, shards * sizeof(stats_shard_t));
+    memset(stats_shards, 0, shards * sizeof(stats_shard_t));
+}
+
+// Начало и конец изменения своей доли
+stats_shard_t *stats_begin(void) {
+    stats_shard_t *s = my_stats;
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return s;
+}
+
+void stats_end(stats_shard_t *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+void stats_syscalls(int n) {
+    stats_shard_t *st = stats_begin();
+    st->syscalls += n;
+    stats_end(st);
+}
+
+// Сумма всех долей в ответ MSG_STATS (без bath_s.mutex)
+void stats_read(msg_t *msg) {
+    memset(msg->wait_ns, 0, sizeof(msg->wait_ns));
+    memset(msg->bath_ns, 0, sizeof(msg->bath_ns));
+    memset(msg->wait_hist, 0, sizeof(msg->wait_hist));
+    memset(msg->bath_hist, 0, sizeof(msg->bath_hist));
+    msg->male_entered = msg->female_entered = 0;
+    msg->reclaimed_disconnect = msg->reclaimed_lease = 0;
+    msg->lock_acquisitions = msg->grants = msg->syscalls = 0;
+
+    for (int i = 0; i < stats_shard_count; i++) {
+        stats_shard_t copy;
+        unsigned seq;
+        do {
+            // изменение доли - несколько сложений, ждем его на месте
+            while ((seq = __atomic_load_n(&stats_shards[i].seq, __ATOMIC_ACQUIRE)) & 1) {
+            }
+            memcpy(&copy, &stats_shards[i], sizeof(copy));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while (__atomic_load_n(&stats_shards[i].seq, __ATOMIC_RELAXED) != seq);
+
+        for (int g = 0; g < 2; g++) {
+            msg->wait_ns[g] += copy.wait_ns[g];
+            msg->bath_ns[g] += copy.bath_ns[g];
+            for (int k = 0; k < WIRE_LAT_BUCKETS; k++) {
+                msg->wait_hist[g][k] += copy.wait_hist[g][k];
+                msg->bath_hist[g][k] += copy.bath_hist[g][k];
+            }
+        }
+        msg->male_entered += copy.entered[MALE];
+        msg->female_entered += copy.entered[FEMALE];
+        msg->reclaimed_disconnect += copy.reclaimed_disconnect;
+        msg->reclaimed_lease += copy.reclaimed_lease;
+        msg->lock_acquisitions += copy.lock_acquisitions;
+        msg->grants += copy.grants;
+        msg->syscalls += copy.syscalls;
+    }
+
+    msg->entered_count = msg->male_entered + msg->female_entered;
+    // Секундные суммы - для клиентов прежнего формата
+    msg->total_wait_time = (msg->wait_ns[0] + msg->wait_ns[1]) / 1000000000;
+    msg->total_bath_time = (msg->bath_ns[0] + msg->bath_ns[1]) / 1000000000;
+}
+
+// Может ли войти студент данного пола (вызывается под mutex).
+// Если очередь серии за полом, которого больше нет, серия сбрасывается
+int can_enter(bath_server_t *b, int gender) {
+    if (b->occupied >= b->capacity) {
+        return 0;
+    }
+    if (b->occupied == 0) {
+        if (b->streak_gender == -1) {
+            return 1;
+        }
+        int allowed = (b->streak_used < b->streak_limit) ? b->streak_gender : !b->streak_gender;
+        if (gender == allowed) {
+            return 1;
+        }
+        if ((allowed == 0 && b->remaining_male == 0) || (allowed == 1 && b->remaining_female == 0)) {
+            b->streak_gender = -1;
+            b->streak_used = 0;
+            return 1;
+        }
+        return 0;
+    }
+    if ((b->bath_gender == MEN_INSIDE && gender != 0) ||
+        (b->bath_gender == WOMEN_INSIDE && gender != 1)) {
+        return 0;
+    }
+    int allowed = (b->streak_used < b->streak_limit) ? b->streak_gender : !b->streak_gender;
+    return gender == allowed;
+}
+
+// ============================================
+// ОТПРАВКА
+// ============================================
+
+bool use_select;            // циклы на select (ключ -s): база для сравнения
+void select_remove(conn_t *c);
+__thread struct loop *my_loop;  // цикл текущего потока (NULL - поток приема)
+
+// Ожидание EPOLLOUT включается и выключается под tx_mutex
+void conn_watch_out(conn_t *c, bool on) {
+    if (c->want_out == on) return;
+    if (use_select) {
+        // Набор записи цикл соберет на следующей итерации
+        c->want_out = on;
+        return;
+    }
+    c->want_out = on;
+    struct epoll_event ev = { .events = EPOLLIN | (on ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    stats_syscalls(1);
+}
+
+// Дописать байты в исходящий буфер (под tx_mutex)
+void conn_append(conn_t *c, const void *data, size_t len) {
+    if (c->tx_len + len > c->tx_cap) {
+        c->tx_cap = (c->tx_len + len) * 2;
+        c->tx = realloc(c->tx, c->tx_cap);
+    }
+    memcpy(c->tx + c->tx_len, data, len);
+    c->tx_len += len;
+}
+
+#ifdef USE_IO_URING
+bool use_uring;             // циклы на io_uring; иначе - запасной путь epoll
+void uring_flush(conn_t *c);
+void uring_conn_destroy(conn_t *c);
+#endif
+
+// Отправка без блокировки: что не ушло, копится до EPOLLOUT.
+// Медленный клиент не задерживает ни цикл, ни остальных клиентов
+void conn_send(conn_t *c, const void *data, size_t len) {
+#ifdef USE_IO_URING
+    if (use_uring) {
+        pthread_mutex_lock(&c->tx_mutex);
+        conn_append(c, data, len);
+        pthread_mutex_unlock(&c->tx_mutex);
+        uring_flush(c);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&c->tx_mutex);
+    size_t sent = 0;
+    if (c->tx_len == 0) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        stats_syscalls(1);
+        if (n > 0) sent = n;
+    }
+    if (sent < len) {
+        conn_append(c, (const char*)data + sent, len - sent);
+        conn_watch_out(c, true);
+    }
+    pthread_mutex_unlock(&c->tx_mutex);
+}
+
+// Кадр сообщения в формате соединения, возвращает длину
+size_t conn_encode(const conn_t *c, const msg_t *msg, uint8_t *frame) {
+    if (c->format == FMT_RAW) {
+        memcpy(frame, msg, WIRE_RAW_SIZE);
+        return WIRE_RAW_SIZE;
+    }
+    return wire_encode(msg, frame);
+}
+
+// Отправка сообщения в формате соединения
+void conn_send_msg(conn_t *c, const msg_t *msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    conn_send(c, frame, conn_encode(c, msg, frame));
+}
+
+// Ответ из-под bath_s.mutex: кадр только дописывается в буфер, а
+// после unlock все ответы соединения уходят одним send
+void conn_queue_msg(bath_server_t *b, conn_t *c, const msg_t *msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t len = conn_encode(c, msg, frame);
+    pthread_mutex_lock(&c->tx_mutex);
+    conn_append(c, frame, len);
+    pthread_mutex_unlock(&c->tx_mutex);
+    if (!c->dirty) {
+        c->dirty = true;
+        c->dirty_next = b->dirty;
+        b->dirty = c;
+    }
+}
+
+// Отправка накопленного; что не ушло, ждет EPOLLOUT
+void conn_flush(conn_t *c) {
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_flush(c);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&c->tx_mutex);
+    while (c->tx_len > 0) {
+        ssize_t n = send(c->fd, c->tx, c->tx_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        stats_syscalls(1);
+        if (n <= 0) break;
+        memmove(c->tx, c->tx + n, c->tx_len - n);
+        c->tx_len -= n;
+    }
+    conn_watch_out(c, c->tx_len > 0);
+    pthread_mutex_unlock(&c->tx_mutex);
+}
+
+// ============================================
+// ДОПУСК В ВАННУЮ
+// ============================================
+
+// Вход студента: учет состояния и отправка разрешения (под mutex)
+void grant(bath_server_t *b, waiter_t *w) {
+    // Время ожидания по часам сервера: от приема JOIN до разрешения
+    uint64_t now = now_ns();
+    stats_shard_t *st = stats_begin();
+    st->wait_ns[w->gender] += now - w->join_ns;
+    st->wait_hist[w->gender][wire_lat_bucket(now - w->join_ns)]++;
+    st->grants++;
+    stats_end(st);
+
+    for (int i = 0; i < CAPACITY; i++) {
+        if (b->slots[i].conn == NULL) {
+            b->slots[i] = (slot_t){ w->conn, w->id, w->gender, now,
+                                    w->service_ns ? now + w->service_ns : 0 };
+            break;
+        }
+    }
+
+    b->occupied++;
+    if (b->occupied == 1) {
+        b->bath_gender = (w->gender == 0) ? MEN_INSIDE : WOMEN_INSIDE;
+    }
+    if (w->gender == 0) b->remaining_male--; else b->remaining_female--;
+
+    if (b->streak_gender == -1) {
+        b->streak_gender = w->gender;
+        b->streak_used = 1;
+    } else if (w->gender == b->streak_gender) {
+        b->streak_used++;
+    } else {
+        b->streak_gender = w->gender;
+        b->streak_used = 1;
+    }
+
+    msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_UPDATE;
+    msg.id = w->id;
+    msg.gender = w->gender;
+    msg.wait_start = w->wait_start;
+    msg.occupied = b->occupied;
+    msg.capacity = b->capacity;
+    msg.streak_gender = b->streak_gender;
+    msg.streak_used = b->streak_used;
+    msg.remaining_male = b->remaining_male;
+    msg.remaining_female = b->remaining_female;
+    conn_queue_msg(b, w->conn, &msg);
+}
+
+void wait_push(bath_server_t *b, waiter_t *w) {
+    wait_queue_t *q = &b->wait_q[w->gender];
+    w->seq = b->join_seq++;
+    w->next = NULL;
+    if (q->tail) q->tail->next = w; else q->head = w;
+    q->tail = w;
+}
+
+waiter_t *wait_pop(bath_server_t *b, int gender) {
+    wait_queue_t *q = &b->wait_q[gender];
+    waiter_t *w = q->head;
+    q->head = w->next;
+    if (q->head == NULL) q->tail = NULL;
+    return w;
+}
+
+// Впустить всех, кого можно (под mutex). Правило входа зависит только
+// от пола, поэтому смотрим лишь головы двух очередей: O(впущенных),
+// а не O(ожидающих). Если могут войти оба пола - первым тот, кто
+// раньше прислал JOIN
+void admit_waiting(bath_server_t *b) {
+    while (1) {
+        waiter_t *m = b->wait_q[MALE].head;
+        waiter_t *f = b->wait_q[FEMALE].head;
+        int cm = m != NULL && can_enter(b, MALE);
+        int cf = f != NULL && can_enter(b, FEMALE);
+        if (!cm && !cf) break;
+
+        int g = (cm && cf) ? (m->seq < f->seq ? MALE : FEMALE) : (cm ? MALE : FEMALE);
+        waiter_t *w = wait_pop(b, g);
+        grant(b, w);
+        free(w);
+    }
+}
+
+// Место студента id с соединения c или NULL (под mutex)
+slot_t *slot_find(bath_server_t *b, conn_t *c, int id) {
+    for (int i = 0; i < CAPACITY; i++) {
+        if (b->slots[i].conn == c && b->slots[i].id == id) {
+            return &b->slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Освобождение места (под mutex); ожидающих впускает вызывающий
+void slot_free(bath_server_t *b, slot_t *s) {
+    s->conn = NULL;
+    b->occupied--;
+    if (b->occupied == 0) {
+        b->bath_gender = EMPTY;
+    }
+}
+
+void note_freed(int id, bool lease);
+
+// Соединение закрыто, не отправив LEAVE: его места возвращаются (под mutex)
+void slot_reclaim(bath_server_t *b, conn_t *c) {
+    for (int i = 0; i < CAPACITY; i++) {
+        if (b->slots[i].conn == c) {
+            note_freed(b->slots[i].id, false);
+            slot_free(b, &b->slots[i]);
+            stats_shard_t *st = stats_begin();
+            st->reclaimed_disconnect++;
+            stats_end(st);
+        }
+    }
+}
+
+// Срок места: выход по таймеру или истечение аренды, 0 - без срока
+uint64_t slot_deadline(const bath_server_t *b, const slot_t *s) {
+    uint64_t at = s->depart_ns;
+    if (b->lease_ns != 0 && (at == 0 || s->grant_ns + b->lease_ns < at)) {
+        at = s->grant_ns + b->lease_ns;
+    }
+    return at;
+}
+
+// Ближайший срок мест (под mutex). Мест CAPACITY, поэтому он ищется
+// перебором, а таймер у сервера один. true - срок изменился, после
+// unlock нужен timer_sync
+bool timer_rearm(bath_server_t *b) {
+    uint64_t next = 0;
+    for (int i = 0; i < CAPACITY; i++) {
+        if (b->slots[i].conn == NULL) continue;
+        uint64_t at = slot_deadline(b, &b->slots[i]);
+        if (at != 0 && (next == 0 || at < next)) next = at;
+    }
+    if (next == b->timer_at) {
+        return false;
+    }
+    __atomic_store_n(&b->timer_at, next, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Взвод timerfd на timer_at (без mutex). Циклы взводят его по очереди
+// под timer_mutex, и последний берет самый свежий срок, поэтому
+// запоздавший взвод не затрет более ранний срок другого цикла.
+// fired - таймер сработал и больше не взведен
+void timer_sync(bath_server_t *b, bool fired) {
+    pthread_mutex_lock(&b->timer_mutex);
+    if (fired) {
+        b->timer_set = 0;
+    }
+    uint64_t next = __atomic_load_n(&b->timer_at, __ATOMIC_ACQUIRE);
+    if (next != b->timer_set) {
+        b->timer_set = next;
+        struct itimerspec its = {
+            .it_value = { .tv_sec = next / 1000000000, .tv_nsec = next % 1000000000 },
+        };
+        timerfd_settime(b->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+        stats_syscalls(1);
+    }
+    pthread_mutex_unlock(&b->timer_mutex);
+}
+
+// Студент вышел: учет времени в ванной и освобождение места (под mutex)
+void slot_complete(bath_server_t *b, slot_t *s, uint64_t now) {
+    long bath = (long)(now - s->grant_ns);
+    stats_shard_t *st = stats_begin();
+    st->bath_ns[s->gender] += bath;
+    st->bath_hist[s->gender][wire_lat_bucket(bath)]++;
+    st->entered[s->gender]++;
+    stats_end(st);
+    slot_free(b, s);
+}
+
+// Сработал timerfd: выходы по таймеру с уведомлением клиента и
+// освобождение мест с истекшей арендой (под mutex)
+void slot_timers(bath_server_t *b) {
+    uint64_t now = now_ns();
+    for (int i = 0; i < CAPACITY; i++) {
+        slot_t *s = &b->slots[i];
+        if (s->conn == NULL) continue;
+        uint64_t at = slot_deadline(b, s);
+        if (at == 0 || at > now) continue;
+
+        if (at == s->depart_ns) {
+            msg_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_LEAVE;
+            msg.id = s->id;
+            msg.gender = s->gender;
+            msg.service_us = (long)(now - s->grant_ns) / 1000;
+            conn_queue_msg(b, s->conn, &msg);
+            slot_complete(b, s, now);
+        } else {
+            note_freed(s->id, true);
+            slot_free(b, s);
+            stats_shard_t *st = stats_begin();
+            st->reclaimed_lease++;
+            stats_end(st);
+        }
+    }
+}
+
+// Соединение закрыто: его ожидающие студенты уходят из очередей (под mutex)
+void drop_waiters(bath_server_t *b, conn_t *c) {
+    for (int g = 0; g < 2; g++) {
+        wait_queue_t *q = &b->wait_q[g];
+        waiter_t *prev = NULL, *w = q->head;
+        while (w != NULL) {
+            waiter_t *next = w->next;
+            if (w->conn == c) {
+                if (prev) prev->next = next; else q->head = next;
+                if (q->tail == w) q->tail = prev;
+                if (g == 0) b->remaining_male--; else b->remaining_female--;
+                free(w);
+            } else {
+                prev = w;
+            }
+            w = next;
+        }
+    }
+}
+
+// ============================================
+// ПАКЕТНАЯ ОБРАБОТКА
+// ============================================
+// Цикл сначала читает все готовые сокеты и только копит JOIN/LEAVE,
+// затем под одним захватом bath_s.mutex применяет их все, закрывает
+// отключившиеся соединения и один раз решает, кого впустить. Ответы
+// копятся в буферах соединений и уходят одним send на соединение.
+// STATS тоже ждет конца такта: ответ учитывает JOIN/LEAVE этого такта.
+// Под mutex нет ни системных вызовов, ни вывода на консоль: timerfd,
+// send и сообщения об освобожденных местах - после unlock. Соединения
+// чужих циклов передаются владельцу: после unlock он может их закрыть.
 
 typedef struct {
+    conn_t *conn;
     msg_type_t type;
     int id;
-    int gender;       // 0=MALE, 1=FEMALE
-    long wait_start;  // время начала ожидания (от клиента)
-    long bath_time;   // время в ванной (от клиента)
-    int occupied;
-    int capacity;
-    int streak_gender;
-    int streak_used;
-    int remaining_male;
-    int remaining_female;
-    long total_wait_time;
-    long total_bath_time;
-    int entered_count;
-    int male_entered;
-    int female_entered;
-} msg_t;
-
-void* handle_client(void *arg) {
-    int client_fd = *(int*)arg;
-    free(arg);
-
-    // Получаем IP-адрес клиента
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    getpeername(client_fd, (struct sockaddr*)&addr, &len);
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-    printf(COLOR_RESET"Клиент подключился с IP: %s\n", client_ip);
+    int gender;
+    long wait_start;
+    long service_us;
+} batch_item_t;
 
-    msg_t msg;
-    while (recv(client_fd, &msg, sizeof(msg), 0) > 0) {
-        pthread_mutex_lock(&bath_s.mutex);
-
-        if (msg.type == MSG_JOIN) {
-            if (msg.gender == 0) bath_s.remaining_male++;
-            else bath_s.remaining_female++;
-
-            while (1) {
-                int can_enter = 0;
-
-                if (bath_s.occupied >= bath_s.capacity) {
-                    can_enter = 0;
-                } else if (bath_s.occupied == 0) {
-                    if (bath_s.streak_gender == -1) {
-                        can_enter = 1;
-                    } else {
-                        int allowed = (bath_s.streak_used < bath_s.streak_limit) ? bath_s.streak_gender : !bath_s.streak_gender;
-                        if (msg.gender == allowed) {
-                            can_enter = 1;
-                        } else {
-                            if ((allowed == 0 && bath_s.remaining_male == 0) || (allowed == 1 && bath_s.remaining_female == 0)) {
-                                bath_s.streak_gender = -1;
-                                bath_s.streak_used = 0;
-                                can_enter = 1;
-                            }
-                        }
-                    }
-                } else {
-                    if ((bath_s.bath_gender == MEN_INSIDE && msg.gender != 0) ||
-                        (bath_s.bath_gender == WOMEN_INSIDE && msg.gender != 1)) {
-                        can_enter = 0;
-                    } else {
-                        int allowed = (bath_s.streak_used < bath_s.streak_limit) ? bath_s.streak_gender : !bath_s.streak_gender;
-                        can_enter = (msg.gender == allowed);
-                    }
-                }
+// Место, освобожденное без LEAVE: сообщение печатается после unlock
+typedef struct {
+    int id;
+    bool lease;             // истекла аренда; иначе - соединение закрыто
+} freed_t;
+
+typedef struct {
+    batch_item_t *items;
+    size_t len, cap;
+    size_t stats;           // из них запросов STATS
+    conn_t *closing;        // соединения, закрытые за этот такт
+    conn_t **flush;         // свои соединения с ответами
+    size_t nflush, flush_cap;
+    struct loop **wake;     // циклы, которым переданы соединения
+    size_t nwake, wake_cap;
+    freed_t *freed;
+    size_t nfreed, freed_cap;
+} batch_t;
+
+__thread batch_t my_batch;  // такт текущего потока цикла
+
+bool loop_flush_push(struct loop *l, conn_t *c);
+void loop_flush_drain(struct loop *l);
+void loop_wake(struct loop *l);
+
+// Запоминание освобожденного места (под mutex)
+void note_freed(int id, bool lease) {
+    batch_t *bt = &my_batch;
+    if (bt->nfreed == bt->freed_cap) {
+        bt->freed_cap = bt->freed_cap ? bt->freed_cap * 2 : CAPACITY;
+        bt->freed = realloc(bt->freed, bt->freed_cap * sizeof(freed_t));
+    }
+    bt->freed[bt->nfreed++] = (freed_t){ id, lease };
+}
 
-                if (can_enter) break;
-                pthread_cond_wait(&bath_s.cond, &bath_s.mutex);
+void bath_lock(bath_server_t *b) {
+    pthread_mutex_lock(&b->mutex);
+    stats_shard_t *st = stats_begin();
+    st->lock_acquisitions++;
+    stats_end(st);
+}
+
+// Завершение захвата (под mutex, перед unlock): впустить ожидающих,
+// найти срок таймера и разобрать соединения с ответами - свои в
+// bt->flush, чужие в списки досылки владельцев. true - взвести таймер
+bool bath_commit(bath_server_t *b, batch_t *bt) {
+    admit_waiting(b);
+    bool rearm = timer_rearm(b);
+    while (b->dirty != NULL) {
+        conn_t *c = b->dirty;
+        b->dirty = c->dirty_next;
+        c->dirty = false;
+        if (c->loop == my_loop) {
+            if (bt->nflush == bt->flush_cap) {
+                bt->flush_cap = bt->flush_cap ? bt->flush_cap * 2 : MAX_EVENTS;
+                bt->flush = realloc(bt->flush, bt->flush_cap * sizeof(conn_t *));
+            }
+            bt->flush[bt->nflush++] = c;
+        } else if (loop_flush_push(c->loop, c)) {
+            if (bt->nwake == bt->wake_cap) {
+                bt->wake_cap = bt->wake_cap ? bt->wake_cap * 2 : 8;
+                bt->wake = realloc(bt->wake, bt->wake_cap * sizeof(struct loop *));
             }
+            bt->wake[bt->nwake++] = c->loop;
+        }
+    }
+    return rearm;
+}
+
+// Сообщение клиента: JOIN, LEAVE и STATS копятся до конца такта
+void handle_msg(conn_t *c, msg_t *msg) {
+    if (msg->type != MSG_JOIN && msg->type != MSG_LEAVE && msg->type != MSG_STATS) {
+        return;
+    }
 
-            // Считаем время ожидания
-            long wait_duration = time(NULL) - msg.wait_start;
-            bath_s.total_wait_time += wait_duration;
+    batch_t *bt = &my_batch;
+    if (msg->type == MSG_STATS) {
+        bt->stats++;
+    }
+    if (bt->len == bt->cap) {
+        bt->cap = bt->cap ? bt->cap * 2 : MAX_EVENTS;
+        bt->items = realloc(bt->items, bt->cap * sizeof(batch_item_t));
+    }
+    bt->items[bt->len++] = (batch_item_t){
+        c, msg->type, msg->id, msg->gender, msg->wait_start, msg->service_us,
+    };
+}
 
-            bath_s.occupied++;
-            if (bath_s.occupied == 1) {
-                bath_s.bath_gender = (msg.gender == 0) ? MEN_INSIDE : WOMEN_INSIDE;
+// Применение JOIN или LEAVE к состоянию ванной (под mutex)
+void apply_msg(bath_server_t *b, const batch_item_t *m, uint64_t now) {
+    if (m->type == MSG_STATS) {
+        return;
+    }
+    if (m->type == MSG_JOIN) {
+        if (m->gender == 0) b->remaining_male++;
+        else b->remaining_female++;
+
+        waiter_t *w = malloc(sizeof(waiter_t));
+        w->id = m->id;
+        w->gender = m->gender ? FEMALE : MALE;
+        w->wait_start = m->wait_start;
+        w->join_ns = now;
+        w->service_ns = m->service_us > 0 ? (uint64_t)m->service_us * 1000 : 0;
+        w->conn = m->conn;
+        wait_push(b, w);
+    }
+    else {
+        // LEAVE без места (повторный или после освобождения по аренде)
+        // не трогает занятость. bath_time клиента не используется:
+        // время меряет сервер
+        slot_t *s = slot_find(b, m->conn, m->id);
+        if (s != NULL) {
+            slot_complete(b, s, now);
+        }
+    }
+}
+
+// Соединение закроется в конце такта: до этого на него могут
+// ссылаться накопленные сообщения
+void conn_close(conn_t *c) {
+    if (!c->closing) {
+        c->closing = true;
+        c->close_next = my_batch.closing;
+        my_batch.closing = c;
+    }
+}
+
+// Освобождение соединения после bath_commit: ссылок на него не осталось
+void conn_destroy(conn_t *c) {
+#ifdef USE_IO_URING
+    if (use_uring) {
+        uring_conn_destroy(c);
+        return;
+    }
+#endif
+    if (use_select) {
+        select_remove(c);
+    } else {
+        epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    }
+    close(c->fd);
+    pthread_mutex_destroy(&c->tx_mutex);
+    free(c->tx);
+    free(c);
+}
+
+// Ответы на STATS такта: после bath_commit, без bath_s.mutex
+void batch_stats(batch_t *bt) {
+    for (size_t i = 0; i < bt->len && bt->stats > 0; i++) {
+        conn_t *c = bt->items[i].conn;
+        if (bt->items[i].type != MSG_STATS) continue;
+        bt->stats--;
+        if (c->closing) continue;
+        msg_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_STATS;
+        msg.id = bt->items[i].id;
+        msg.gender = bt->items[i].gender;
+        stats_read(&msg);
+        conn_send_msg(c, &msg);
+    }
+    bt->stats = 0;
+}
+
+/**
+ * Конец такта цикла: все накопленное - под одним захватом mutex
+ * timer_due - сработал timerfd сервера
+ */
+void batch_apply(bool timer_due) {
+    batch_t *bt = &my_batch;
+    if (bt->len == 0 && bt->closing == NULL && !timer_due) {
+        return;
+    }
+    // только STATS: состояние ванной не меняется, mutex не нужен
+    if (bt->len == bt->stats && bt->closing == NULL && !timer_due) {
+        batch_stats(bt);
+        bt->len = 0;
+        return;
+    }
+
+    bath_lock(&bath_s);
+    uint64_t now = now_ns();
+    for (size_t i = 0; i < bt->len; i++) {
+        apply_msg(&bath_s, &bt->items[i], now);
+    }
+    for (conn_t *c = bt->closing; c != NULL; c = c->close_next) {
+        drop_waiters(&bath_s, c);
+        slot_reclaim(&bath_s, c);
+    }
+    if (timer_due) {
+        __atomic_store_n(&bath_s.timer_at, 0, __ATOMIC_RELEASE);
+        slot_timers(&bath_s);
+    }
+    bool rearm = bath_commit(&bath_s, bt);
+    pthread_mutex_unlock(&bath_s.mutex);
+
+    if (rearm || timer_due) {
+        timer_sync(&bath_s, timer_due);
+    }
+    for (size_t i = 0; i < bt->nflush; i++) {
+        if (!bt->flush[i]->closing) {
+            conn_flush(bt->flush[i]);
+        }
+    }
+    bt->nflush = 0;
+    for (size_t i = 0; i < bt->nwake; i++) {
+        loop_wake(bt->wake[i]);
+        stats_syscalls(1);
+    }
+    bt->nwake = 0;
+    for (size_t i = 0; i < bt->nfreed; i++) {
+        printf(COLOR_YELLOW"Место студента %d освобождено: %s\n"COLOR_RESET, bt->freed[i].id,
+               bt->freed[i].lease ? "истекла аренда" : "соединение закрыто");
+    }
+    bt->nfreed = 0;
+
+    batch_stats(bt);
+    // Закрываемые соединения могут стоять в списке досылки: другие
+    // циклы ставят их туда только под mutex, пока на них есть ссылки
+    if (bt->closing != NULL) {
+        loop_flush_drain(my_loop);
+    }
+    while (bt->closing != NULL) {
+        conn_t *c = bt->closing;
+        bt->closing = c->close_next;
+        conn_destroy(c);
+    }
+    bt->len = 0;
+}
+
+// ============================================
+// ЦИКЛЫ СОБЫТИЙ
+// ============================================
+
+typedef struct loop {
+    int epfd;
+    pthread_t thread;
+    int kick_fd;            // eventfd пинков: досылка, новые соединения (select, io_uring)
+    pthread_mutex_t kick_mutex;
+    conn_t *kicks;
+    conn_t *flushes;        // соединения с ответами от других циклов (под kick_mutex)
+    // select: соединения цикла и наборы дескрипторов (по set_words слов)
+    conn_t **conns;
+    int nconns, conns_cap;
+    fd_mask *rset, *wset;
+    int set_words;
+#ifdef USE_IO_URING
+    uring_t ring;
+    uring_bufs_t bufs;      // буферы multishot recv
+    uint64_t timer_val;     // приемник чтения timerfd (первый цикл)
+    uint64_t kick_val;
+#endif
+} loop_t;
+
+loop_t *loops;
+int loop_count = LOOP_THREADS;
+
+void loop_wake(loop_t *l) {
+    uint64_t one = 1;
+    if (write(l->kick_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd write");
+    }
+}
+
+// Ответы соединению чужого цикла: отправит владелец (под bath_s.mutex,
+// без системных вызовов). true - список был пуст, владельца надо
+// разбудить после unlock
+bool loop_flush_push(loop_t *l, conn_t *c) {
+    pthread_mutex_lock(&l->kick_mutex);
+    bool wake = l->flushes == NULL;
+    if (!c->flush_queued) {
+        c->flush_queued = true;
+        c->flush_next = l->flushes;
+        l->flushes = c;
+    }
+    pthread_mutex_unlock(&l->kick_mutex);
+    return wake;
+}
+
+// Досылка ответов, переданных другими циклами (поток цикла-владельца).
+// Флаг снимается до отправки: ответ, дописанный после, поставит
+// соединение в список заново
+void loop_flush_drain(loop_t *l) {
+    pthread_mutex_lock(&l->kick_mutex);
+    conn_t *c = l->flushes;
+    l->flushes = NULL;
+    pthread_mutex_unlock(&l->kick_mutex);
+
+    while (c != NULL) {
+        pthread_mutex_lock(&l->kick_mutex);
+        conn_t *next = c->flush_next;
+        c->flush_queued = false;
+        pthread_mutex_unlock(&l->kick_mutex);
+        if (!c->closing) {
+            conn_flush(c);
+        }
+        c = next;
+    }
+}
+
+// Передать соединение циклу-владельцу: список пинков и пробуждение
+void loop_kick(loop_t *l, conn_t *c) {
+    pthread_mutex_lock(&l->kick_mutex);
+    c->kick_next = l->kicks;
+    l->kicks = c;
+    pthread_mutex_unlock(&l->kick_mutex);
+    loop_wake(l);
+}
+
+// Разбор накопленных байт на сообщения. Возвращает -1 при неверном кадре
+int conn_parse(conn_t *c) {
+    size_t pos = 0;
+    if (c->format == FMT_UNKNOWN && c->rx_len > 0) {
+        c->format = c->rx[0] == WIRE_MAGIC ? FMT_WIRE : FMT_RAW;
+    }
+
+    while (pos < c->rx_len) {
+        msg_t msg;
+        if (c->format == FMT_RAW) {
+            if (c->rx_len - pos < WIRE_RAW_SIZE) break;
+            memset(&msg, 0, sizeof(msg));
+            memcpy(&msg, c->rx + pos, WIRE_RAW_SIZE);
+            pos += WIRE_RAW_SIZE;
+        } else {
+            int n = wire_decode(c->rx + pos, c->rx_len - pos, &msg);
+            if (n < 0) return -1;
+            if (n == 0) break;
+            pos += n;
+        }
+        handle_msg(c, &msg);
+    }
+
+    memmove(c->rx, c->rx + pos, c->rx_len - pos);
+    c->rx_len -= pos;
+    return 0;
+}
+
+// Чтение всего доступного; сообщения собираются из любых кусков.
+// Возвращает -1, если соединение закрыто или прислало неверный кадр
+int conn_read(conn_t *c) {
+    while (1) {
+        ssize_t n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+        stats_syscalls(1);
+        if (n > 0) {
+            c->rx_len += n;
+            if (conn_parse(c) < 0) {
+                return -1;
             }
-            if (msg.gender == 0) bath_s.remaining_male--; else bath_s.remaining_female--;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+}
 
-            if (bath_s.streak_gender == -1) {
-                bath_s.streak_gender = msg.gender;
-                bath_s.streak_used = 1;
-            } else if (msg.gender == bath_s.streak_gender) {
-                bath_s.streak_used++;
-            } else {
-                bath_s.streak_gender = msg.gender;
-                bath_s.streak_used = 1;
+void* loop_thread(void *arg) {
+    loop_t *l = arg;
+    struct epoll_event events[MAX_EVENTS];
+    my_stats = &stats_shards[l - loops];
+    my_loop = l;
+
+    while (1) {
+        int n = epoll_wait(l->epfd, events, MAX_EVENTS, -1);
+        stats_syscalls(1);
+        bool timer_due = false;
+        for (int i = 0; i < n; i++) {
+            conn_t *c = events[i].data.ptr;
+            if (c == NULL) {
+                // timerfd сервера (только в первом цикле)
+                uint64_t expirations;
+                timer_due = read(bath_s.timer_fd, &expirations, sizeof(expirations)) > 0;
+                stats_syscalls(1);
+                continue;
+            }
+            if (events[i].data.ptr == l) {
+                // пинок: ответы от других циклов
+                uint64_t v;
+                if (read(l->kick_fd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+                    perror("eventfd read");
+                }
+                stats_syscalls(1);
+                loop_flush_drain(l);
+                continue;
             }
+            if (events[i].events & EPOLLOUT) {
+                conn_flush(c);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (conn_read(c) < 0) {
+                    //printf(COLOR_RESET"Клиент отключился\n");
+                    conn_close(c);
+                }
+            }
+        }
+        batch_apply(timer_due);
+    }
+    return NULL;
+}
 
-            msg.type = MSG_UPDATE;
-            msg.occupied = bath_s.occupied;
-            msg.capacity = bath_s.capacity;
-            msg.streak_gender = bath_s.streak_gender;
-            msg.streak_used = bath_s.streak_used;
-            msg.remaining_male = bath_s.remaining_male;
-            msg.remaining_female = bath_s.remaining_female;
-            send(client_fd, &msg, sizeof(msg), 0);
-        }
-        else if (msg.type == MSG_LEAVE) {
-            bath_s.occupied--;
-            bath_s.total_bath_time += msg.bath_time;
-            bath_s.entered_count++;
-            if (msg.gender == 0) {
-                bath_s.male_entered++;
-            } else {
-                bath_s.female_entered++;
+// ============================================
+// ЦИКЛЫ НА SELECT (ключ -s)
+// ============================================
+// База для сравнения с epoll и io_uring: набор дескрипторов ядро не
+// помнит, поэтому цикл пересобирает его и передает целиком на каждой
+// итерации, а после select перебирает все свои соединения, а не только
+// готовые. Наборы размечаются вручную: дескрипторов у цикла может быть
+// больше FD_SETSIZE (1024), ядро же ограничивает их только RLIMIT_NOFILE.
+
+static inline void fds_set(fd_mask *s, int fd) {
+    s[fd / NFDBITS] |= (fd_mask)1 << (fd % NFDBITS);
+}
+
+static inline bool fds_isset(const fd_mask *s, int fd) {
+    return s[fd / NFDBITS] & ((fd_mask)1 << (fd % NFDBITS));
+}
+
+// Пинок: новые соединения от потока приема - в массив цикла, ответы
+// от других циклов - в сокеты
+void select_on_kick(loop_t *l) {
+    uint64_t v;
+    if (read(l->kick_fd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+        perror("eventfd read");
+    }
+    stats_syscalls(1);
+
+    pthread_mutex_lock(&l->kick_mutex);
+    conn_t *list = l->kicks;
+    l->kicks = NULL;
+    pthread_mutex_unlock(&l->kick_mutex);
+
+    while (list != NULL) {
+        conn_t *c = list;
+        list = c->kick_next;
+        if (l->nconns == l->conns_cap) {
+            l->conns_cap = l->conns_cap ? l->conns_cap * 2 : MAX_EVENTS;
+            l->conns = realloc(l->conns, l->conns_cap * sizeof(conn_t *));
+        }
+        c->sel_index = l->nconns;
+        l->conns[l->nconns++] = c;
+    }
+    loop_flush_drain(l);
+}
+
+// Удаление из массива цикла-владельца (из conn_destroy)
+void select_remove(conn_t *c) {
+    loop_t *l = c->loop;
+    conn_t *last = l->conns[--l->nconns];
+    l->conns[c->sel_index] = last;
+    last->sel_index = c->sel_index;
+}
+
+void* select_loop_thread(void *arg) {
+    loop_t *l = arg;
+    bool timer_owner = l == loops;
+    my_stats = &stats_shards[l - loops];
+    my_loop = l;
+
+    while (1) {
+        int maxfd = l->kick_fd;
+        if (timer_owner && bath_s.timer_fd > maxfd) maxfd = bath_s.timer_fd;
+        for (int i = 0; i < l->nconns; i++) {
+            if (l->conns[i]->fd > maxfd) maxfd = l->conns[i]->fd;
+        }
+        int words = maxfd / NFDBITS + 1;
+        if (words > l->set_words) {
+            l->set_words = words * 2;
+            l->rset = realloc(l->rset, l->set_words * sizeof(fd_mask));
+            l->wset = realloc(l->wset, l->set_words * sizeof(fd_mask));
+        }
+        memset(l->rset, 0, words * sizeof(fd_mask));
+        memset(l->wset, 0, words * sizeof(fd_mask));
+
+        fds_set(l->rset, l->kick_fd);
+        if (timer_owner) fds_set(l->rset, bath_s.timer_fd);
+        for (int i = 0; i < l->nconns; i++) {
+            conn_t *c = l->conns[i];
+            fds_set(l->rset, c->fd);
+            if (c->want_out) {
+                fds_set(l->wset, c->fd);
             }
+        }
 
-            if (bath_s.occupied == 0) {
-                bath_s.bath_gender = EMPTY;
+        int n = select(maxfd + 1, (fd_set *)l->rset, (fd_set *)l->wset, NULL, NULL);
+        stats_syscalls(1);
+        if (n < 0) {
+            if (errno != EINTR) perror("select");
+            continue;
+        }
+
+        bool timer_due = false;
+        if (timer_owner && fds_isset(l->rset, bath_s.timer_fd)) {
+            uint64_t expirations;
+            timer_due = read(bath_s.timer_fd, &expirations, sizeof(expirations)) > 0;
+            stats_syscalls(1);
+        }
+        // Массив не меняется до конца такта: закрытые соединения
+        // удаляет batch_apply, новые добавляются после перебора
+        for (int i = 0; i < l->nconns; i++) {
+            conn_t *c = l->conns[i];
+            if (fds_isset(l->wset, c->fd)) {
+                conn_flush(c);
             }
+            if (fds_isset(l->rset, c->fd) && conn_read(c) < 0) {
+                conn_close(c);
+            }
+        }
+        if (fds_isset(l->rset, l->kick_fd)) {
+            select_on_kick(l);
+        }
+        batch_apply(timer_due);
+    }
+    return NULL;
+}
+
+#ifdef USE_IO_URING
+// ============================================
+// ЦИКЛЫ НА IO_URING
+// ============================================
+// Каждый цикл держит свое кольцо: multishot recv в кольцо буферов на
+// каждое соединение и SEND на ответы. Multishot accept на обоих
+// слушающих сокетах держит первый цикл и раздает соединения по кругу,
+// как поток приема в варианте с epoll. Все SQE такта
+// уходят ядру тем же io_uring_enter, которым цикл ждет следующих
+// событий: на сообщение не остается отдельных вызовов recv/send.
+//
+// У соединения не больше одного SEND в полете: он несет все ответы,
+// накопленные к концу такта, порядок байт сохраняется без связывания
+// SQE (IOSQE_IO_LINK). Разрешение для соединения чужого цикла
+// отправляет владелец: его будит пинок через eventfd (список досылки,
+// как в epoll). Тем же пинком владелец получает новое соединение и
+// взводит на нем recv.
 
-            pthread_cond_broadcast(&bath_s.cond);
+// Вид запроса - в младших битах user_data, выше - указатель
+enum { UD_RECV, UD_SEND, UD_ACCEPT, UD_TIMER, UD_KICK, UD_CANCEL };
+#define UD_KIND_MASK 7ull
+
+typedef struct {
+    int fd;
+    bool local;             // AF_UNIX: без TCP_NODELAY
+} listener_t;
+
+listener_t listeners[2];
+int listener_count;
+unsigned next_loop;         // цикл для следующего соединения
+
+static inline uint64_t ud_make(void *p, int kind) {
+    return (uint64_t)(uintptr_t)p | kind;
+}
+
+void uring_conn_free(conn_t *c) {
+    close(c->fd);
+    pthread_mutex_destroy(&c->tx_mutex);
+    free(c->tx);
+    free(c->tx_out);
+    free(c);
+}
+
+// Завершился запрос соединения (только цикл-владелец)
+void uring_conn_put(conn_t *c) {
+    if (__atomic_sub_fetch(&c->ops, 1, __ATOMIC_ACQ_REL) == 0 && c->destroyed) {
+        uring_conn_free(c);
+    }
+}
+
+void uring_recv_arm(loop_t *l, conn_t *c) {
+    uring_prep_recv_multishot(uring_sqe(&l->ring), c->fd, l->bufs.bgid, ud_make(c, UD_RECV));
+    c->recv_armed = true;
+    __atomic_add_fetch(&c->ops, 1, __ATOMIC_RELAXED);
+}
+
+// Следующий SEND соединения: накопленное в tx уходит целиком
+// (владелец, под tx_mutex)
+void uring_send_next(conn_t *c) {
+    if (c->tx_out_len > 0 || c->tx_len == 0 || c->closing) {
+        return;
+    }
+    char *buf = c->tx_out;
+    size_t cap = c->tx_out_cap;
+    c->tx_out = c->tx;
+    c->tx_out_cap = c->tx_cap;
+    c->tx_out_len = c->tx_len;
+    c->tx_out_off = 0;
+    c->tx = buf;
+    c->tx_cap = cap;
+    c->tx_len = 0;
+    uring_prep_send(uring_sqe(&c->loop->ring), c->fd, c->tx_out, c->tx_out_len, ud_make(c, UD_SEND));
+    __atomic_add_fetch(&c->ops, 1, __ATOMIC_RELAXED);
+}
+
+// Отправка накопленного (только поток цикла-владельца: кольцо его)
+void uring_flush(conn_t *c) {
+    pthread_mutex_lock(&c->tx_mutex);
+    uring_send_next(c);
+    pthread_mutex_unlock(&c->tx_mutex);
+}
+
+// Соединение закрыто: recv отменяется, память освобождает последний
+// завершившийся запрос
+void uring_conn_destroy(conn_t *c) {
+    c->destroyed = true;
+    if (c->recv_armed) {
+        uring_prep_cancel(uring_sqe(&c->loop->ring), ud_make(c, UD_RECV), ud_make(NULL, UD_CANCEL));
+    }
+    if (__atomic_load_n(&c->ops, __ATOMIC_ACQUIRE) == 0) {
+        uring_conn_free(c);
+    }
+}
+
+// Сообщения из буфера recv: дописываются в rx кусками, сколько влезет
+int conn_feed(conn_t *c, const char *data, size_t len) {
+    while (len > 0) {
+        size_t take = sizeof(c->rx) - c->rx_len;
+        if (take == 0) return -1;
+        if (take > len) take = len;
+        memcpy(c->rx + c->rx_len, data, take);
+        c->rx_len += take;
+        data += take;
+        len -= take;
+        if (conn_parse(c) < 0) return -1;
+    }
+    return 0;
+}
+
+void uring_on_accept(loop_t *l, listener_t *ls, int res, unsigned flags) {
+    if (res >= 0) {
+        if (!ls->local) {
+            int one = 1;
+            setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
         }
-        else if (msg.type == MSG_STATS) {
-            msg.total_wait_time = bath_s.total_wait_time;
-            msg.total_bath_time = bath_s.total_bath_time;
-            msg.entered_count = bath_s.entered_count;
-            msg.male_entered = bath_s.male_entered;
-            msg.female_entered = bath_s.female_entered;
-            send(client_fd, &msg, sizeof(msg), 0);
+        printf(COLOR_RESET"Клиент подключился (%s)\n", ls->local ? "AF_UNIX" : "TCP");
+        conn_t *c = calloc(1, sizeof(conn_t));
+        c->fd = res;
+        c->epfd = -1;
+        c->loop = &loops[next_loop++ % loop_count];
+        pthread_mutex_init(&c->tx_mutex, NULL);
+        if (c->loop == l) {
+            uring_recv_arm(l, c);
+        } else {
+            c->ops = 1;
+            loop_kick(c->loop, c);
         }
+    } else {
+        errno = -res;
+        perror("accept");
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        uring_prep_accept_multishot(uring_sqe(&l->ring), ls->fd, ud_make(ls, UD_ACCEPT));
+    }
+}
 
-        pthread_mutex_unlock(&bath_s.mutex);
+void uring_on_recv(loop_t *l, conn_t *c, int res, unsigned flags) {
+    if (res > 0) {
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (!c->closing && conn_feed(c, uring_bufs_at(&l->bufs, bid), res) < 0) {
+            conn_close(c);
+        }
+        uring_bufs_put(&l->bufs, bid);
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // recv снят: конец данных, ошибка или кончились буферы
+        c->recv_armed = false;
+        if (res == -ENOBUFS) {
+            // Возвращенные в этой итерации буферы ядро еще не видит: без
+            // публикации новый recv снова сразу получил бы ENOBUFS
+            uring_bufs_publish(&l->bufs);
+        }
+        if (!c->closing && (res > 0 || res == -ENOBUFS)) {
+            uring_recv_arm(l, c);
+        } else {
+            conn_close(c);
+        }
+        uring_conn_put(c);
     }
+}
+
+void uring_on_send(conn_t *c, int res) {
+    pthread_mutex_lock(&c->tx_mutex);
+    if (res < 0) {
+        c->tx_out_len = 0;
+        conn_close(c);
+    } else if ((c->tx_out_off += res) < c->tx_out_len) {
+        // Сокет принял не все: досылаем остаток тем же буфером
+        uring_prep_send(uring_sqe(&c->loop->ring), c->fd, c->tx_out + c->tx_out_off,
+                        c->tx_out_len - c->tx_out_off, ud_make(c, UD_SEND));
+        __atomic_add_fetch(&c->ops, 1, __ATOMIC_RELAXED);
+    } else {
+        c->tx_out_len = 0;
+        uring_send_next(c);
+    }
+    pthread_mutex_unlock(&c->tx_mutex);
+    uring_conn_put(c);
+}
+
+void uring_on_kick(loop_t *l) {
+    pthread_mutex_lock(&l->kick_mutex);
+    conn_t *list = l->kicks;
+    l->kicks = NULL;
+    pthread_mutex_unlock(&l->kick_mutex);
+
+    while (list != NULL) {
+        conn_t *c = list;
+        list = c->kick_next;
+        if (!c->recv_armed && !c->closing) {
+            uring_recv_arm(l, c);   // новое соединение от первого цикла
+        }
+        uring_conn_put(c);
+    }
+    loop_flush_drain(l);
+    uring_prep_read(uring_sqe(&l->ring), l->kick_fd, &l->kick_val, sizeof(l->kick_val), ud_make(NULL, UD_KICK));
+}
+
+void* uring_loop_thread(void *arg) {
+    loop_t *l = arg;
+    my_stats = &stats_shards[l - loops];
+    my_loop = l;
 
-    //printf(COLOR_RESET"Клиент с IP %s отключился\n", client_ip);
-    close(client_fd);
+    while (1) {
+        // Отправка SQE такта и ожидание событий - один системный вызов
+        int ret = uring_enter(&l->ring, 1);
+        stats_syscalls(1);
+        if (ret < 0 && ret != -EBUSY) {
+            errno = -ret;
+            perror("io_uring_enter");
+        }
+
+        bool timer_due = false;
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_cqe_peek(&l->ring)) != NULL) {
+            uint64_t ud = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring_cqe_seen(&l->ring);
+
+            void *p = (void *)(uintptr_t)(ud & ~UD_KIND_MASK);
+            switch (ud & UD_KIND_MASK) {
+            case UD_ACCEPT:
+                uring_on_accept(l, p, res, flags);
+                break;
+            case UD_RECV:
+                uring_on_recv(l, p, res, flags);
+                break;
+            case UD_SEND:
+                uring_on_send(p, res);
+                break;
+            case UD_TIMER:
+                timer_due |= res > 0;
+                uring_prep_read(uring_sqe(&l->ring), bath_s.timer_fd, &l->timer_val,
+                                sizeof(l->timer_val), ud_make(NULL, UD_TIMER));
+                break;
+            case UD_KICK:
+                uring_on_kick(l);
+                break;
+            default:
+                break;
+            }
+        }
+        uring_bufs_publish(&l->bufs);
+        batch_apply(timer_due);
+    }
     return NULL;
 }
 
-int main() {
+/**
+ * Запуск циклов на io_uring. false - ядро не дает кольцо или кольцо
+ * буферов (старше 6.0, io_uring_disabled): сервер работает на epoll
+ */
+bool uring_start(int server_fd, int unix_fd) {
+    for (int i = 0; i < loop_count; i++) {
+        loop_t *l = &loops[i];
+        int err = uring_init(&l->ring, URING_ENTRIES);
+        if (err == 0) {
+            err = uring_bufs_init(&l->ring, &l->bufs, 0, URING_BUFS, URING_BUF_SIZE);
+        }
+        if (err < 0) {
+            fprintf(stderr, "io_uring недоступен (%s), циклы на epoll\n", strerror(-err));
+            for (int k = 0; k <= i; k++) {
+                uring_bufs_free(&loops[k].bufs);
+                uring_exit(&loops[k].ring);
+            }
+            return false;
+        }
+    }
+
+    listeners[listener_count++] = (listener_t){ server_fd, false };
+    if (unix_fd >= 0) {
+        listeners[listener_count++] = (listener_t){ unix_fd, true };
+    }
+    // Чтения колец ждут данных сами: timerfd переводится в блокирующий режим
+    fcntl(bath_s.timer_fd, F_SETFL, fcntl(bath_s.timer_fd, F_GETFL) & ~O_NONBLOCK);
+    use_uring = true;
+
+    for (int i = 0; i < loop_count; i++) {
+        loop_t *l = &loops[i];
+        l->kick_fd = eventfd(0, EFD_CLOEXEC);
+        pthread_mutex_init(&l->kick_mutex, NULL);
+        uring_prep_read(uring_sqe(&l->ring), l->kick_fd, &l->kick_val, sizeof(l->kick_val), ud_make(NULL, UD_KICK));
+        if (i == 0) {
+            for (int k = 0; k < listener_count; k++) {
+                uring_prep_accept_multishot(uring_sqe(&l->ring), listeners[k].fd,
+                                            ud_make(&listeners[k], UD_ACCEPT));
+            }
+            uring_prep_read(uring_sqe(&l->ring), bath_s.timer_fd, &l->timer_val,
+                            sizeof(l->timer_val), ud_make(NULL, UD_TIMER));
+        }
+        pthread_create(&l->thread, NULL, uring_loop_thread, l);
+    }
+    return true;
+}
+#endif
+
+// Слушающий сокет AF_UNIX для клиентов на этой же машине: тот же
+// протокол без стека TCP. Возвращает -1, если создать не удалось
+int unix_listen(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Слишком длинный путь сокета: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket AF_UNIX");
+        return -1;
+    }
+    unlink(path);   // файл от прошлого запуска
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, BACKLOG) < 0) {
+        perror("bind/listen AF_UNIX");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
     bath_server_init(&bath_s);
 
+    const char *unix_path = UNIX_PATH;
+    int opt_c;
+    while ((opt_c = getopt(argc, argv, "t:l:u:s")) != -1) {
+        if (opt_c == 't') {
+            loop_count = atoi(optarg);
+        } else if (opt_c == 'l') {
+            bath_s.lease_ns = (uint64_t)(atof(optarg) * 1e9);
+        } else if (opt_c == 'u') {
+            unix_path = optarg;
+        } else if (opt_c == 's') {
+            use_select = true;
+        } else {
+            fprintf(stderr, "Использование: %s [-t потоков_цикла] [-l аренда_места_сек] "
+                            "[-u путь_локального_сокета] [-s]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (loop_count <= 0) loop_count = LOOP_THREADS;
+    stats_init(loop_count);
+    loops = calloc(loop_count, sizeof(loop_t));
+
     int server_fd, new_socket;
     struct sockaddr_in address;
     int opt = 1;
@@ -238,19 +1560,87 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    printf(COLOR_GREEN"Сервер запущен на порту %d\n", PORT);
+    int unix_fd = unix_path[0] ? unix_listen(unix_path) : -1;
 
+    printf(COLOR_GREEN"Сервер запущен на порту %d, циклов событий: %d\n"COLOR_RESET, PORT, loop_count);
+    if (unix_fd >= 0) {
+        printf(COLOR_GREEN"Локальный сокет: %s\n"COLOR_RESET, unix_path);
+    }
+
+#ifdef USE_IO_URING
+    // Циклы на io_uring принимают подключения сами
+    if (!use_select && uring_start(server_fd, unix_fd)) {
+        printf(COLOR_GREEN"Ввод-вывод: io_uring\n"COLOR_RESET);
+        pthread_join(loops[0].thread, NULL);
+        return 0;
+    }
+#endif
+
+    // Циклы событий: соединения раздаются по кругу, ожидающие студенты
+    // потоков не занимают
+    printf(COLOR_GREEN"Ввод-вывод: %s\n"COLOR_RESET, use_select ? "select" : "epoll");
+    for (int i = 0; i < loop_count; i++) {
+        if (use_select) {
+            loops[i].kick_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            pthread_mutex_init(&loops[i].kick_mutex, NULL);
+            pthread_create(&loops[i].thread, NULL, select_loop_thread, &loops[i]);
+            continue;
+        }
+        loops[i].epfd = epoll_create1(0);
+        if (i == 0) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+            epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, bath_s.timer_fd, &ev);
+        }
+        loops[i].kick_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        pthread_mutex_init(&loops[i].kick_mutex, NULL);
+        struct epoll_event kev = { .events = EPOLLIN, .data.ptr = &loops[i] };
+        epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, loops[i].kick_fd, &kev);
+        pthread_create(&loops[i].thread, NULL, loop_thread, &loops[i]);
+    }
+
+    // Прием с обоих слушающих сокетов
+    struct pollfd lfd[2] = { { .fd = server_fd, .events = POLLIN }, { .fd = unix_fd, .events = POLLIN } };
+    unsigned next_loop = 0;
     while (true) {
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, &addrlen)) < 0) {
-            perror("accept");
+        if (poll(lfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
             exit(EXIT_FAILURE);
         }
+        bool local = !(lfd[0].revents & POLLIN);
+        addrlen = sizeof(address);
+        if ((new_socket = accept(local ? unix_fd : server_fd, local ? NULL : (struct sockaddr *)&address,
+                                 local ? NULL : &addrlen)) < 0) {
+            perror("accept");
+            continue;
+        }
+
+        if (local) {
+            printf(COLOR_RESET"Клиент подключился через %s\n", unix_path);
+        } else {
+            // Получаем IP-адрес клиента
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &(address.sin_addr), client_ip, INET_ADDRSTRLEN);
+            printf(COLOR_RESET"Клиент подключился с IP: %s\n", client_ip);
+
+            // Ответы - кадры в десяток байт: без TCP_NODELAY разрешение
+            // задерживается алгоритмом Нейгла
+            int one = 1;
+            setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        fcntl(new_socket, F_SETFL, fcntl(new_socket, F_GETFL) | O_NONBLOCK);
+        conn_t *c = calloc(1, sizeof(conn_t));
+        c->fd = new_socket;
+        c->loop = &loops[next_loop++ % loop_count];
+        c->epfd = c->loop->epfd;
+        pthread_mutex_init(&c->tx_mutex, NULL);
+        if (use_select) {
+            loop_kick(c->loop, c);
+            continue;
+        }
 
-        int *fd_ptr = malloc(sizeof(int));
-        *fd_ptr = new_socket;
-        pthread_t thread;
-        pthread_create(&thread, NULL, handle_client, fd_ptr);
-        pthread_detach(thread);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->fd, &ev);
     }
 
     return 0;
@@ -0,0 +1,315 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// ============================================
+// МИНИМАЛЬНОЕ КОЛЬЦО IO_URING (ЛР4)
+// ============================================
+// Прямые системные вызовы io_uring_setup/enter/register без liburing:
+// нужны только заголовки ядра. Одно кольцо принадлежит одному потоку:
+// SQE заполняет и CQE разбирает только он, поэтому кольца индексов
+// синхронизируются с ядром лишь барьерами acquire/release.
+//
+// accept и recv - многоразовые (multishot): запрос остается взведенным
+// и дает CQE на каждое соединение или кусок данных, пока в CQE стоит
+// IORING_CQE_F_MORE. Данные recv ядро само кладет в буферы из кольца
+// буферов (provided buffer ring), номер буфера приходит в флагах CQE.
+// Требуется ядро 6.0+.
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_array;
+    unsigned sq_mask, sq_entries;
+    unsigned sq_local;          // заполнено SQE, включая неопубликованные
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *cq_head, *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring_mem;
+    size_t ring_size;
+} uring_t;
+
+// Кольцо буферов для recv: count буферов по size байт, группа bgid
+typedef struct {
+    struct io_uring_buf_ring *ring;
+    char *data;
+    unsigned size, count;
+    uint16_t tail;
+    uint16_t bgid;
+} uring_bufs_t;
+
+/**
+ * @brief Создание кольца
+ * @param r - кольцо
+ * @param entries - размер очереди отправки (степень двойки)
+ * @return 0 или -errno (ядро без io_uring, запрещено sysctl и т.п.)
+ */
+static inline int uring_init(uring_t* r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    // Очередь завершений больше: multishot дает по нескольку CQE на SQE.
+    // COOP_TASKRUN: завершения дорабатываются при входе в io_uring_enter,
+    // без прерывания потока
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = entries * 4;
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd);
+        return -ENOSYS;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->ring_mem = mmap(NULL, r->ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->ring_mem == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->ring_mem != MAP_FAILED) munmap(r->ring_mem, r->ring_size);
+        if (r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_size);
+        memset(r, 0, sizeof(*r));
+        close(fd);
+        return -ENOMEM;
+    }
+
+    char* m = r->ring_mem;
+    r->fd = fd;
+    r->sq_head = (unsigned*)(m + p.sq_off.head);
+    r->sq_tail = (unsigned*)(m + p.sq_off.tail);
+    r->sq_array = (unsigned*)(m + p.sq_off.array);
+    r->sq_mask = *(unsigned*)(m + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_local = *r->sq_tail;
+    r->cq_head = (unsigned*)(m + p.cq_off.head);
+    r->cq_tail = (unsigned*)(m + p.cq_off.tail);
+    r->cq_mask = *(unsigned*)(m + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(m + p.cq_off.cqes);
+    return 0;
+}
+
+// Освобождение кольца (после успешного uring_init; для обнуленного - ничего)
+static inline void uring_exit(uring_t* r) {
+    if (r->ring_mem != NULL) {
+        munmap(r->sqes, r->sqes_size);
+        munmap(r->ring_mem, r->ring_size);
+        close(r->fd);
+    }
+    memset(r, 0, sizeof(*r));
+}
+
+static inline int uring_enter_ext(uring_t* r, unsigned wait_nr, unsigned flags, const void* arg, size_t argsz) {
+    __atomic_store_n(r->sq_tail, r->sq_local, __ATOMIC_RELEASE);
+    unsigned pending = r->sq_local - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (wait_nr) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    int n;
+    do {
+        n = (int)syscall(__NR_io_uring_enter, r->fd, pending, wait_nr, flags, arg, argsz);
+    } while (n < 0 && errno == EINTR);
+    return n < 0 ? -errno : n;
+}
+
+/**
+ * @brief Передача SQE ядру и ожидание завершений
+ * @param r - кольцо
+ * @param wait_nr - сколько CQE ждать (0 - только отправить)
+ * @return число принятых ядром SQE или -errno
+ */
+static inline int uring_enter(uring_t* r, unsigned wait_nr) {
+    return uring_enter_ext(r, wait_nr, 0, NULL, 0);
+}
+
+/**
+ * @brief То же с пределом ожидания (IORING_ENTER_EXT_ARG, ядро 5.11+)
+ * @param timeout_ms - сколько ждать завершений, мс
+ * @return число принятых ядром SQE, -ETIME по истечении срока или -errno
+ */
+static inline int uring_enter_timeout(uring_t* r, unsigned wait_nr, int timeout_ms) {
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long long)(timeout_ms % 1000) * 1000000,
+    };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    return uring_enter_ext(r, wait_nr, IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+// Свободных мест в очереди отправки: цепочку связанных SQE нельзя
+// разрывать передачей ядру на середине
+static inline unsigned uring_sq_space(uring_t* r) {
+    return r->sq_entries - (r->sq_local - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @brief Следующий свободный SQE (обнуленный)
+ *
+ * Если очередь отправки заполнена, накопленное сначала уходит ядру.
+ */
+static inline struct io_uring_sqe* uring_sqe(uring_t* r) {
+    while (r->sq_local - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+        uring_enter(r, 0);
+    }
+    unsigned idx = r->sq_local & r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local++;
+    return sqe;
+}
+
+// Очередное завершение или NULL; после разбора - uring_cqe_seen
+static inline struct io_uring_cqe* uring_cqe_peek(uring_t* r) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &r->cqes[head & r->cq_mask];
+}
+
+static inline void uring_cqe_seen(uring_t* r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// ============================================
+// ПОДГОТОВКА ЗАПРОСОВ
+// ============================================
+
+// Многоразовый accept: CQE с новым сокетом на каждое подключение
+static inline void uring_prep_accept_multishot(struct io_uring_sqe* sqe, int fd, uint64_t ud) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = ud;
+}
+
+// Многоразовый recv в буферы группы bgid
+static inline void uring_prep_recv_multishot(struct io_uring_sqe* sqe, int fd, uint16_t bgid, uint64_t ud) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = ud;
+}
+
+static inline void uring_prep_send(struct io_uring_sqe* sqe, int fd, const void* buf, size_t len, uint64_t ud) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = ud;
+}
+
+// Чтение timerfd/eventfd (смещение -1: текущая позиция)
+static inline void uring_prep_read(struct io_uring_sqe* sqe, int fd, void* buf, size_t len, uint64_t ud) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = ud;
+}
+
+// Отмена запроса по его user_data
+static inline void uring_prep_cancel(struct io_uring_sqe* sqe, uint64_t target, uint64_t ud) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = ud;
+}
+
+// Отмена всех запросов с этим user_data (ядро 5.19+)
+static inline void uring_prep_cancel_all(struct io_uring_sqe* sqe, uint64_t target, uint64_t ud) {
+    uring_prep_cancel(sqe, target, ud);
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+}
+
+// ============================================
+// КОЛЬЦО БУФЕРОВ
+// ============================================
+
+// Вернуть буфер в кольцо; ядро увидит его после uring_bufs_publish
+static inline void uring_bufs_put(uring_bufs_t* b, uint16_t bid) {
+    struct io_uring_buf* e = &b->ring->bufs[b->tail & (b->count - 1)];
+    e->addr = (uint64_t)(uintptr_t)(b->data + (size_t)bid * b->size);
+    e->len = b->size;
+    e->bid = bid;
+    b->tail++;
+}
+
+static inline void uring_bufs_publish(uring_bufs_t* b) {
+    __atomic_store_n(&b->ring->tail, b->tail, __ATOMIC_RELEASE);
+}
+
+static inline char* uring_bufs_at(const uring_bufs_t* b, uint16_t bid) {
+    return b->data + (size_t)bid * b->size;
+}
+
+/**
+ * @brief Регистрация кольца буферов в кольце io_uring
+ * @param r - кольцо
+ * @param b - кольцо буферов
+ * @param bgid - номер группы (указывается в recv)
+ * @param count - число буферов (степень двойки, до 32768)
+ * @param size - размер буфера
+ * @return 0 или -errno (ядро старше 5.19)
+ */
+static inline int uring_bufs_init(uring_t* r, uring_bufs_t* b, uint16_t bgid, unsigned count, unsigned size) {
+    memset(b, 0, sizeof(*b));
+    b->size = size;
+    b->count = count;
+    b->bgid = bgid;
+    b->ring = mmap(NULL, count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    b->data = mmap(NULL, (size_t)count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->ring == MAP_FAILED || b->data == MAP_FAILED) {
+        return -ENOMEM;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)b->ring;
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -errno;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        uring_bufs_put(b, (uint16_t)i);
+    }
+    uring_bufs_publish(b);
+    return 0;
+}
+
+// Снятие отображений кольца буферов (и после неудачного uring_bufs_init).
+// Регистрацию в кольце io_uring снимает его закрытие
+static inline void uring_bufs_free(uring_bufs_t* b) {
+    if (b->ring != NULL && b->ring != MAP_FAILED) {
+        munmap(b->ring, b->count * sizeof(struct io_uring_buf));
+    }
+    if (b->data != NULL && b->data != MAP_FAILED) {
+        munmap(b->data, (size_t)b->count * b->size);
+    }
+    memset(b, 0, sizeof(*b));
+}
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================
+// КОМПАКТНОЕ КОДИРОВАНИЕ СООБЩЕНИЙ server_/client_
+// ============================================
+// Кадр: WIRE_MAGIC, версия, тип, длина нагрузки (varint), нагрузка.
+// Нагрузка - поля сообщения в порядке wire_layout[тип], каждое как
+// varint от zigzag(значения), то есть little-endian группами по 7 бит
+// и не зависит от размера long и порядка байт машины. Нулевые поля
+// в конце не передаются: отсутствующее поле читается как 0, лишние
+// поля в конце пропускаются, поэтому новые поля можно добавлять в
+// конец раскладки без смены версии.
+//
+// Прежний формат (сырой msg_t без полей после female_entered,
+// WIRE_RAW_SIZE байт) начинается с типа - байта 0..3, а не с
+// WIRE_MAGIC, поэтому сервер различает клиентов по первому байту.
+
+#define WIRE_MAGIC 0xB5
+#define WIRE_VERSION 1
+#define WIRE_HDR_MAX 8              // magic, версия, тип, varint длины
+#define WIRE_MAX_PAYLOAD 4096
+#define WIRE_MAX_FRAME (WIRE_HDR_MAX + WIRE_MAX_PAYLOAD)
+
+// Гистограмма времен: корзина k - от 2^k до 2^(k+1) мкс (корзина 0 -
+// меньше 2 мкс), последняя корзина - все, что больше
+#define WIRE_LAT_BUCKETS 40
+
+// Структура сообщений. Ответ MSG_UPDATE на MSG_JOIN несет id студента:
+// клиент может вести по одному соединению сколько угодно студентов
+typedef enum {
+    MSG_JOIN,
+    MSG_LEAVE,
+    MSG_UPDATE,
+    MSG_STATS
+} msg_type_t;
+
+#define MSG_TYPES 4
+#define WIRE_LAYOUT_MAX 24          // полей в раскладке одного типа
+
+// Сообщение в памяти (в прежнем формате передавалось как есть)
+typedef struct {
+    msg_type_t type;
+    int id;
+    int gender;       // 0=MALE, 1=FEMALE
+    long wait_start;  // время начала ожидания (от клиента)
+    long bath_time;   // время в ванной (от клиента)
+    int occupied;
+    int capacity;
+    int streak_gender;
+    int streak_used;
+    int remaining_male;
+    int remaining_female;
+    long total_wait_time;
+    long total_bath_time;
+    int entered_count;
+    int male_entered;
+    int female_entered;
+
+    // Только в кадрах wire.h (MSG_STATS): времена по часам сервера,
+    // индекс - пол
+    long wait_ns[2];        // JOIN -> разрешение
+    long bath_ns[2];        // разрешение -> LEAVE
+    uint32_t wait_hist[2][WIRE_LAT_BUCKETS];
+    uint32_t bath_hist[2][WIRE_LAT_BUCKETS];
+    int reclaimed_disconnect;   // мест освобождено при обрыве соединения
+    int reclaimed_lease;        // мест освобождено по истечении аренды
+    long service_us;            // JOIN: время в ванной, выход отмеряет сервер;
+                                // LEAVE от сервера: фактическое время
+    long lock_acquisitions;     // захватов mutex состояния ванной
+    long grants;                // выданных разрешений
+    long syscalls;              // системных вызовов циклов событий сервера
+} msg_t;
+
+#define WIRE_RAW_SIZE offsetof(msg_t, wait_ns)
+
+typedef enum {
+    F_END,
+    F_ID,
+    F_GENDER,
+    F_WAIT_START,
+    F_BATH_TIME,
+    F_OCCUPIED,
+    F_CAPACITY,
+    F_STREAK_GENDER,
+    F_STREAK_USED,
+    F_REMAINING_MALE,
+    F_REMAINING_FEMALE,
+    F_TOTAL_WAIT_TIME,
+    F_TOTAL_BATH_TIME,
+    F_ENTERED_COUNT,
+    F_MALE_ENTERED,
+    F_FEMALE_ENTERED,
+    F_WAIT_NS_M,
+    F_WAIT_NS_F,
+    F_BATH_NS_M,
+    F_BATH_NS_F,
+    F_WAIT_HIST_M,          // поля-массивы: число корзин, затем корзины
+    F_WAIT_HIST_F,
+    F_BATH_HIST_M,
+    F_BATH_HIST_F,
+    F_RECLAIMED_DISCONNECT,
+    F_RECLAIMED_LEASE,
+    F_SERVICE_US,
+    F_LOCK_ACQUISITIONS,
+    F_GRANTS,
+    F_SYSCALLS,
+} wire_field_t;
+
+// Поля каждого типа: LEAVE несет только id, пол и время
+static const uint8_t wire_layout[MSG_TYPES][WIRE_LAYOUT_MAX] = {
+    [MSG_JOIN] = { F_ID, F_GENDER, F_WAIT_START, F_SERVICE_US },
+    [MSG_LEAVE] = { F_ID, F_GENDER, F_BATH_TIME, F_SERVICE_US },
+    [MSG_UPDATE] = { F_ID, F_GENDER, F_OCCUPIED, F_CAPACITY, F_STREAK_GENDER,
+                     F_STREAK_USED, F_REMAINING_MALE, F_REMAINING_FEMALE, F_WAIT_START },
+    [MSG_STATS] = { F_TOTAL_WAIT_TIME, F_TOTAL_BATH_TIME, F_ENTERED_COUNT,
+                    F_MALE_ENTERED, F_FEMALE_ENTERED,
+                    F_WAIT_NS_M, F_WAIT_NS_F, F_BATH_NS_M, F_BATH_NS_F,
+                    F_WAIT_HIST_M, F_WAIT_HIST_F, F_BATH_HIST_M, F_BATH_HIST_F,
+                    F_RECLAIMED_DISCONNECT, F_RECLAIMED_LEASE,
+                    F_LOCK_ACQUISITIONS, F_GRANTS, F_SYSCALLS },
+};
+
+static inline unsigned wire_lat_bucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us < 2) {
+        return 0;
+    }
+    unsigned k = 63 - __builtin_clzll(us);
+    return k < WIRE_LAT_BUCKETS ? k : WIRE_LAT_BUCKETS - 1;
+}
+
+/**
+ * @brief Квантиль гистограммы времен
+ * @param h - корзины
+ * @param q - доля от 0 до 1
+ * @return верхняя граница корзины в мкс, 0 - гистограмма пуста
+ */
+static inline uint64_t wire_lat_quantile(const uint32_t* h, double q) {
+    uint64_t total = 0, seen = 0;
+    for (unsigned k = 0; k < WIRE_LAT_BUCKETS; k++) {
+        total += h[k];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * total + 0.5);
+    if (rank < 1) rank = 1;
+    for (unsigned k = 0; k < WIRE_LAT_BUCKETS; k++) {
+        seen += h[k];
+        if (seen >= rank) {
+            return (uint64_t)2 << k;
+        }
+    }
+    return (uint64_t)2 << (WIRE_LAT_BUCKETS - 1);
+}
+
+// Поле-массив или NULL для скалярного поля
+static inline uint32_t* wire_field_array(msg_t* m, int f) {
+    switch (f) {
+    case F_WAIT_HIST_M: return m->wait_hist[0];
+    case F_WAIT_HIST_F: return m->wait_hist[1];
+    case F_BATH_HIST_M: return m->bath_hist[0];
+    case F_BATH_HIST_F: return m->bath_hist[1];
+    default: return NULL;
+    }
+}
+
+static inline int64_t wire_field_get(const msg_t* m, int f) {
+    switch (f) {
+    case F_ID: return m->id;
+    case F_GENDER: return m->gender;
+    case F_WAIT_START: return m->wait_start;
+    case F_BATH_TIME: return m->bath_time;
+    case F_OCCUPIED: return m->occupied;
+    case F_CAPACITY: return m->capacity;
+    case F_STREAK_GENDER: return m->streak_gender;
+    case F_STREAK_USED: return m->streak_used;
+    case F_REMAINING_MALE: return m->remaining_male;
+    case F_REMAINING_FEMALE: return m->remaining_female;
+    case F_TOTAL_WAIT_TIME: return m->total_wait_time;
+    case F_TOTAL_BATH_TIME: return m->total_bath_time;
+    case F_ENTERED_COUNT: return m->entered_count;
+    case F_MALE_ENTERED: return m->male_entered;
+    case F_FEMALE_ENTERED: return m->female_entered;
+    case F_WAIT_NS_M: return m->wait_ns[0];
+    case F_WAIT_NS_F: return m->wait_ns[1];
+    case F_BATH_NS_M: return m->bath_ns[0];
+    case F_BATH_NS_F: return m->bath_ns[1];
+    case F_RECLAIMED_DISCONNECT: return m->reclaimed_disconnect;
+    case F_RECLAIMED_LEASE: return m->reclaimed_lease;
+    case F_SERVICE_US: return m->service_us;
+    case F_LOCK_ACQUISITIONS: return m->lock_acquisitions;
+    case F_GRANTS: return m->grants;
+    case F_SYSCALLS: return m->syscalls;
+    default: return 0;
+    }
+}
+
+static inline void wire_field_set(msg_t* m, int f, int64_t v) {
+    switch (f) {
+    case F_ID: m->id = (int)v; break;
+    case F_GENDER: m->gender = (int)v; break;
+    case F_WAIT_START: m->wait_start = (long)v; break;
+    case F_BATH_TIME: m->bath_time = (long)v; break;
+    case F_OCCUPIED: m->occupied = (int)v; break;
+    case F_CAPACITY: m->capacity = (int)v; break;
+    case F_STREAK_GENDER: m->streak_gender = (int)v; break;
+    case F_STREAK_USED: m->streak_used = (int)v; break;
+    case F_REMAINING_MALE: m->remaining_male = (int)v; break;
+    case F_REMAINING_FEMALE: m->remaining_female = (int)v; break;
+    case F_TOTAL_WAIT_TIME: m->total_wait_time = (long)v; break;
+    case F_TOTAL_BATH_TIME: m->total_bath_time = (long)v; break;
+    case F_ENTERED_COUNT: m->entered_count = (int)v; break;
+    case F_MALE_ENTERED: m->male_entered = (int)v; break;
+    case F_FEMALE_ENTERED: m->female_entered = (int)v; break;
+    case F_WAIT_NS_M: m->wait_ns[0] = (long)v; break;
+    case F_WAIT_NS_F: m->wait_ns[1] = (long)v; break;
+    case F_BATH_NS_M: m->bath_ns[0] = (long)v; break;
+    case F_BATH_NS_F: m->bath_ns[1] = (long)v; break;
+    case F_RECLAIMED_DISCONNECT: m->reclaimed_disconnect = (int)v; break;
+    case F_RECLAIMED_LEASE: m->reclaimed_lease = (int)v; break;
+    case F_SERVICE_US: m->service_us = (long)v; break;
+    case F_LOCK_ACQUISITIONS: m->lock_acquisitions = (long)v; break;
+    case F_GRANTS: m->grants = (long)v; break;
+    case F_SYSCALLS: m->syscalls = (long)v; break;
+    default: break;
+    }
+}
+
+static inline size_t wire_put_varint(uint8_t* p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/**
+ * @brief Чтение varint
+ * @param p - данные
+ * @param avail - сколько байт доступно
+ * @param v - значение
+ * @return число байт, 0 - нужно больше данных, -1 - длиннее 10 байт
+ */
+static inline int wire_get_varint(const uint8_t* p, size_t avail, uint64_t* v) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < 10; i++) {
+        if (i == avail) {
+            return 0;
+        }
+        r |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *v = r;
+            return (int)i + 1;
+        }
+    }
+    return -1;
+}
+
+static inline uint64_t wire_zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t wire_unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/**
+ * @brief Кодирование сообщения в кадр
+ * @param m - сообщение
+ * @param out - буфер не меньше WIRE_MAX_FRAME
+ * @return длина кадра
+ */
+static inline size_t wire_encode(const msg_t* m, uint8_t* out) {
+    uint8_t payload[WIRE_MAX_PAYLOAD];
+    size_t len = 0;
+    const uint8_t* layout = wire_layout[(unsigned)m->type % MSG_TYPES];
+    for (int i = 0; i < WIRE_LAYOUT_MAX && layout[i] != F_END; i++) {
+        const uint32_t* arr = wire_field_array((msg_t*)m, layout[i]);
+        if (arr == NULL) {
+            len += wire_put_varint(payload + len, wire_zigzag(wire_field_get(m, layout[i])));
+            continue;
+        }
+        // массив без нулевых корзин в конце
+        unsigned n = WIRE_LAT_BUCKETS;
+        while (n > 0 && arr[n - 1] == 0) {
+            n--;
+        }
+        len += wire_put_varint(payload + len, n);
+        for (unsigned k = 0; k < n; k++) {
+            len += wire_put_varint(payload + len, arr[k]);
+        }
+    }
+    // нулевые поля в конце не передаются
+    while (len > 0 && payload[len - 1] == 0) {
+        len--;
+    }
+
+    size_t n = 0;
+    out[n++] = WIRE_MAGIC;
+    out[n++] = WIRE_VERSION;
+    out[n++] = (uint8_t)m->type;
+    n += wire_put_varint(out + n, len);
+    memcpy(out + n, payload, len);
+    return n + len;
+}
+
+/**
+ * @brief Разбор одного кадра из накопленных данных
+ * @param buf - принятые данные
+ * @param avail - сколько байт принято
+ * @param m - сообщение
+ * @return длина кадра, 0 - нужно больше данных, -1 - неверный кадр
+ *         (не тот magic или версия, неизвестный тип, слишком длинный)
+ */
+static inline int wire_decode(const uint8_t* buf, size_t avail, msg_t* m) {
+    if (avail < 4) {
+        return avail > 0 && buf[0] != WIRE_MAGIC ? -1 : 0;
+    }
+    if (buf[0] != WIRE_MAGIC || buf[1] != WIRE_VERSION || buf[2] >= MSG_TYPES) {
+        return -1;
+    }
+    uint64_t len;
+    int hl = wire_get_varint(buf + 3, avail - 3, &len);
+    if (hl < 0) {
+        return -1;
+    }
+    if (hl == 0) {
+        return 0;
+    }
+    if (len > WIRE_MAX_PAYLOAD) {
+        return -1;
+    }
+    if (avail < 3 + (size_t)hl + len) {
+        return 0;
+    }
+
+    memset(m, 0, sizeof(*m));
+    m->type = (msg_type_t)buf[2];
+    const uint8_t* p = buf + 3 + hl;
+    const uint8_t* layout = wire_layout[m->type];
+    size_t pos = 0;
+    for (int i = 0; i < WIRE_LAYOUT_MAX && layout[i] != F_END && pos < len; i++) {
+        uint64_t v;
+        int n = wire_get_varint(p + pos, len - pos, &v);
+        if (n <= 0) {
+            return -1;
+        }
+        pos += n;
+        uint32_t* arr = wire_field_array(m, layout[i]);
+        if (arr == NULL) {
+            wire_field_set(m, layout[i], wire_unzigzag(v));
+            continue;
+        }
+        if (v > WIRE_LAT_BUCKETS) {
+            return -1;
+        }
+        for (unsigned k = 0; k < v; k++) {
+            uint64_t c;
+            n = wire_get_varint(p + pos, len - pos, &c);
+            if (n <= 0) {
+                return -1;
+            }
+            arr[k] = (uint32_t)c;
+            pos += n;
+        }
+    }
+    return (int)(3 + hl + len);
+}
+
+#endif